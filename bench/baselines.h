@@ -0,0 +1,134 @@
+#ifndef RCU_BENCH_BASELINES_H
+#define RCU_BENCH_BASELINES_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+// Reclamation schemes RCU is compared against. Only what the benchmarks need is implemented.
+namespace bench {
+    // Michael's hazard pointers with a single hazard per thread. A reader publishes the pointer it is about
+    // to dereference and rereads the source to check that it was not unpublished in between; a writer
+    // frees retired pointers once a scan of every thread's hazard no longer finds them.
+    class hazard_pointers {
+        // threads holding a slot at once, slots of exited threads are reused
+        static constexpr std::size_t max_threads = 512;
+
+        struct alignas(64) slot_t {
+            std::atomic<const void*> ptr{};
+            std::atomic<bool> in_use{};
+        };
+        struct retired_t {
+            void* p;
+            void (*deleter)(void*);
+        };
+        struct thread_rec_t {
+            slot_t* slot{};
+            std::vector<retired_t> retired;
+
+            ~thread_rec_t() {
+                if (!slot)
+                    return;
+                slot->ptr.store(nullptr, std::memory_order_release);
+                scan(retired);
+                if (!retired.empty()) {
+                    std::scoped_lock guard{orphan_lock};
+                    orphans.insert(orphans.end(), retired.begin(), retired.end());
+                }
+                slot->in_use.store(false, std::memory_order_release);
+            }
+        };
+
+        static std::array<slot_t, max_threads> slots;
+        inline static std::atomic<std::size_t> num_slots{};
+        // pointers retired by threads that exited while they were still protected
+        inline static std::mutex orphan_lock;
+        inline static std::vector<retired_t> orphans;
+        static thread_local thread_rec_t rec;
+
+        static slot_t& acquire_slot() {
+            auto& r = rec;
+            if (r.slot) [[likely]]
+                return *r.slot;
+            for (std::size_t i = 0;; i++) {
+                // checked in release builds too, the benchmarks run with NDEBUG
+                if (i == max_threads) [[unlikely]] {
+                    std::fputs("bench::hazard_pointers: more than max_threads threads at once\n", stderr);
+                    std::abort();
+                }
+                bool expected = false;
+                if (slots[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    r.slot = &slots[i];
+                    auto n = num_slots.load(std::memory_order_relaxed);
+                    while (n < i + 1 && !num_slots.compare_exchange_weak(n, i + 1, std::memory_order_release)) {}
+                    return *r.slot;
+                }
+            }
+        }
+        static void scan(std::vector<retired_t>& list) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::vector<const void*> hazards;
+            for (std::size_t i = 0, n = num_slots.load(std::memory_order_acquire); i < n; i++) {
+                if (const auto* p = slots[i].ptr.load(std::memory_order_acquire))
+                    hazards.push_back(p);
+            }
+            std::ranges::sort(hazards);
+            std::erase_if(list, [&](const retired_t& r) {
+                if (std::ranges::binary_search(hazards, r.p))
+                    return false;
+                r.deleter(r.p);
+                return true;
+            });
+        }
+        static void adopt_orphans(std::vector<retired_t>& list) {
+            std::scoped_lock guard{orphan_lock};
+            list.insert(list.end(), orphans.begin(), orphans.end());
+            orphans.clear();
+        }
+
+    public:
+        // the returned pointer stays valid until the next protect or clear on this thread
+        template<class T>
+        static T* protect(const std::atomic<T*>& src) noexcept {
+            auto& slot = acquire_slot();
+            auto* p = src.load(std::memory_order_relaxed);
+            while (true) {
+                slot.ptr.store(p, std::memory_order_seq_cst);
+                auto* q = src.load(std::memory_order_acquire);
+                if (p == q)
+                    return p;
+                p = q;
+            }
+        }
+        static void clear() noexcept {
+            acquire_slot().ptr.store(nullptr, std::memory_order_release);
+        }
+        // p must already be unpublished
+        template<class T>
+        static void retire(T* p) {
+            acquire_slot();
+            auto& list = rec.retired;
+            list.push_back({p, [](void* q) {
+                delete static_cast<T*>(q);
+            }});
+            if (list.size() >= 2 * num_slots.load(std::memory_order_relaxed) + 64) {
+                adopt_orphans(list);
+                scan(list);
+            }
+        }
+        // frees whatever this thread retired that is no longer protected, for use between benchmark runs
+        static void drain() {
+            adopt_orphans(rec.retired);
+            scan(rec.retired);
+        }
+    };
+    // defined out of line, the nested types are incomplete inside the class
+    inline std::array<hazard_pointers::slot_t, hazard_pointers::max_threads> hazard_pointers::slots{};
+    inline thread_local hazard_pointers::thread_rec_t hazard_pointers::rec;
+}
+
+
+#endif //RCU_BENCH_BASELINES_H
@@ -0,0 +1,243 @@
+#ifndef RCU_BENCH_H
+#define RCU_BENCH_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <ranges>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../rcu.h"
+#include "../rcu_deque.h"
+#include "baselines.h"
+#include <benchmark/benchmark.h>
+
+// Shared pieces of the benchmark targets: the containers under test behind one read/write interface, and
+// the sweeps and latency percentiles every target reports.
+namespace bench {
+    inline constexpr std::size_t island_size = 256;
+    using island = std::array<std::size_t, island_size>;
+
+    // sums len elements from first, for any random access range of pointers to islands
+    template<class Islands>
+    std::size_t sum_range(const Islands& islands, std::size_t first, std::size_t len) noexcept {
+        std::size_t sum = 0;
+        while (len) {
+            const auto& isl = *islands[first / island_size];
+            const auto offset = first % island_size;
+            const auto n = std::min(len, island_size - offset);
+            sum = std::accumulate(isl.begin() + offset, isl.begin() + offset + n, sum);
+            first += n;
+            len -= n;
+        }
+        return sum;
+    }
+
+    // Every implementation holds size elements in islands of island_size. read sums a range inside one
+    // read-side critical section, write replaces one element so that readers never see a partial update.
+    // Threads call thread_online before their first operation and thread_offline after their last.
+    template<class Domain>
+    struct rcu_impl_t {
+        static inline const std::string name = std::is_same_v<Domain, rcu::rcu_qsbr_domain> ? "rcu_qsbr" : "rcu";
+
+        Domain& dom;
+        rcu::deque<std::size_t, Domain> data;
+
+        explicit rcu_impl_t(const std::size_t size) :
+            dom{default_domain()}, data{std::ranges::views::iota(0ul, size), dom} {}
+        ~rcu_impl_t() {
+            rcu::rcu_synchronize(dom);
+        }
+        static Domain& default_domain() noexcept {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>)
+                return rcu::rcu_qsbr_default_domain();
+            else
+                return rcu::rcu_default_domain();
+        }
+
+        static void thread_online() {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>)
+                rcu::rcu_thread_online(default_domain());
+        }
+        static void thread_offline() {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>)
+                rcu::rcu_thread_offline(default_domain());
+        }
+        // qsbr threads pass through a quiescent state after every operation, reads included
+        static void quiescent_state() {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>)
+                rcu::rcu_quiescent_state(default_domain());
+        }
+        std::size_t read(const std::size_t first, const std::size_t len) {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>) {
+                const auto sum = sum_range(data.ref_span(), first, len);
+                quiescent_state();
+                return sum;
+            }
+            else {
+                std::scoped_lock guard{dom};
+                return sum_range(data.ref_span(), first, len);
+            }
+        }
+        void write(const std::size_t pos, const std::size_t val) {
+            data.set(pos, val);
+            quiescent_state();
+        }
+    };
+    using rcu_impl = rcu_impl_t<rcu::rcu_domain>;
+    using rcu_qsbr_impl = rcu_impl_t<rcu::rcu_qsbr_domain>;
+
+    struct shared_mutex_impl {
+        static inline const std::string name = "shared_mutex";
+
+        rcu::shared_mutex_deque<std::size_t> data;
+
+        explicit shared_mutex_impl(const std::size_t size) : data{std::ranges::views::iota(0ul, size)} {}
+
+        static void thread_online() {}
+        static void thread_offline() {}
+        std::size_t read(const std::size_t first, const std::size_t len) {
+            std::shared_lock guard{data._write_lock};
+            return sum_range(data.ref_span(), first, len);
+        }
+        void write(const std::size_t pos, const std::size_t val) {
+            std::unique_lock guard{data._write_lock};
+            (*const_cast<island*>(data.ref_span()[pos / island_size]))[pos % island_size] = val;
+        }
+    };
+
+    // the copy-on-write snapshot shared by the baselines, islands are shared between snapshots
+    struct snapshot {
+        std::vector<std::shared_ptr<const island>> islands;
+
+        explicit snapshot(const std::size_t size) {
+            for (std::size_t first = 0; first < size; first += island_size) {
+                auto isl = std::make_shared<island>();
+                std::iota(isl->begin(), isl->end(), first);
+                islands.push_back(std::move(isl));
+            }
+        }
+        snapshot(const snapshot& rhs, const std::size_t pos, const std::size_t val) : islands{rhs.islands} {
+            auto isl = std::make_shared<island>(*islands[pos / island_size]);
+            (*isl)[pos % island_size] = val;
+            islands[pos / island_size] = std::move(isl);
+        }
+    };
+
+    struct atomic_shared_ptr_impl {
+        static inline const std::string name = "atomic_shared_ptr";
+
+        std::mutex write_lock;
+        std::atomic<std::shared_ptr<const snapshot>> data;
+
+        explicit atomic_shared_ptr_impl(const std::size_t size) : data{std::make_shared<const snapshot>(size)} {}
+
+        static void thread_online() {}
+        static void thread_offline() {}
+        std::size_t read(const std::size_t first, const std::size_t len) {
+            const auto s = data.load(std::memory_order_acquire);
+            return sum_range(s->islands, first, len);
+        }
+        void write(const std::size_t pos, const std::size_t val) {
+            std::scoped_lock guard{write_lock};
+            data.store(std::make_shared<const snapshot>(*data.load(std::memory_order_relaxed), pos, val), std::memory_order_release);
+        }
+    };
+
+    struct hazard_pointer_impl {
+        static inline const std::string name = "hazard_pointer";
+
+        std::mutex write_lock;
+        std::atomic<snapshot*> data;
+
+        explicit hazard_pointer_impl(const std::size_t size) : data{new snapshot{size}} {}
+        ~hazard_pointer_impl() {
+            delete data.load(std::memory_order_relaxed);
+            hazard_pointers::drain();
+        }
+
+        static void thread_online() {}
+        static void thread_offline() {}
+        std::size_t read(const std::size_t first, const std::size_t len) {
+            const auto* s = hazard_pointers::protect(data);
+            const auto sum = sum_range(s->islands, first, len);
+            hazard_pointers::clear();
+            return sum;
+        }
+        void write(const std::size_t pos, const std::size_t val) {
+            std::scoped_lock guard{write_lock};
+            auto* old = data.load(std::memory_order_relaxed);
+            data.store(new snapshot{*old, pos, val}, std::memory_order_seq_cst);
+            hazard_pointers::retire(old);
+        }
+    };
+
+    struct xorshift {
+        std::uint64_t state;
+
+        std::uint64_t operator()() noexcept {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    };
+
+    // 1, 2, 4, ... threads up to the machine's core count
+    inline void thread_sweep(benchmark::internal::Benchmark* b) {
+        const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        for (int threads = 1; threads < cores; threads *= 2) {
+            b->Threads(threads);
+        }
+        b->Threads(cores);
+        b->UseRealTime();
+    }
+
+    // Collects latency samples from every thread of a run and reports their percentiles from thread 0.
+    // Created by thread 0 before the timed loop and only destroyed by the next run, since the other
+    // threads may still be leaving the barrier when thread 0 reports.
+    class latency_recorder {
+        std::mutex lock;
+        std::vector<std::int64_t> samples;
+        std::barrier<> merged;
+
+    public:
+        explicit latency_recorder(const int threads) : merged{threads} {}
+
+        void merge(const std::vector<std::int64_t>& local) {
+            {
+                std::scoped_lock guard{lock};
+                samples.insert(samples.end(), local.begin(), local.end());
+            }
+            merged.arrive_and_wait();
+        }
+        // requires every thread to have merged
+        void report(benchmark::State& state, const std::string& prefix) {
+            if (samples.empty())
+                return;
+            for (auto&& [suffix, q] : {std::pair{"_p50_ns", 0.5}, std::pair{"_p99_ns", 0.99}, std::pair{"_p999_ns", 0.999}}) {
+                const auto nth = samples.begin() + static_cast<std::ptrdiff_t>(q * static_cast<double>(samples.size() - 1));
+                std::ranges::nth_element(samples, nth);
+                state.counters[prefix + suffix] = static_cast<double>(*nth);
+            }
+        }
+    };
+
+    template<class F>
+    std::int64_t time_ns(F&& f) {
+        const auto start = std::chrono::steady_clock::now();
+        std::forward<F>(f)();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+#endif //RCU_BENCH_H
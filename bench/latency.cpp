@@ -0,0 +1,55 @@
+#include "bench.h"
+
+// rcu_synchronize latency against range(0) reader threads that each sum range(1) elements per critical
+// section back to back. Time is the mean, the counters are percentiles over every call.
+template<class Impl>
+static void BM_synchronize_latency(benchmark::State& state) {
+    const auto readers = static_cast<std::size_t>(state.range(0));
+    const auto len = static_cast<std::size_t>(state.range(1));
+    constexpr std::size_t size = 1 << 16;
+    state.SetLabel(Impl::name);
+
+    Impl data{size};
+    std::vector<std::jthread> threads;
+    for (std::size_t t = 0; t < readers; t++) {
+        threads.emplace_back([&data, len, t](const std::stop_token& stop) {
+            bench::xorshift rng{t * 0x9e3779b97f4a7c15ull + 1};
+            Impl::thread_online();
+            while (!stop.stop_requested()) {
+                benchmark::DoNotOptimize(data.read(rng() % (size - len + 1), len));
+            }
+            Impl::thread_offline();
+        });
+    }
+
+    auto& dom = Impl::default_domain();
+    bench::latency_recorder latency{1};
+    std::vector<std::int64_t> samples;
+    for ([[maybe_unused]] auto _ : state) {
+        samples.push_back(bench::time_ns([&] {
+            rcu::rcu_synchronize(dom);
+        }));
+    }
+    threads.clear();
+
+    latency.merge(samples);
+    latency.report(state, "synchronize");
+    state.counters["readers"] = static_cast<double>(readers);
+}
+
+static void reader_sweep(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"readers", "cs_len"});
+    const long cores = std::max(1u, std::thread::hardware_concurrency());
+    for (auto&& len : {16l, 4096l, 65536l}) {
+        for (long readers = 1; readers < cores; readers *= 2) {
+            b->Args({readers, len});
+        }
+        b->Args({cores, len});
+    }
+    b->UseRealTime()->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(BM_synchronize_latency, bench::rcu_impl)->Apply(reader_sweep);
+BENCHMARK_TEMPLATE(BM_synchronize_latency, bench::rcu_qsbr_impl)->Apply(reader_sweep);
+
+BENCHMARK_MAIN();
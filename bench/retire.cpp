@@ -0,0 +1,154 @@
+#include "bench.h"
+
+// Retire-heavy loads: every write unpublishes and retires a small object, so throughput is bound by the
+// cost of reclamation rather than by copying. Each thread works on random cells out of num_cells.
+namespace {
+    constexpr std::size_t num_cells = 1024;
+
+    struct value {
+        std::array<std::size_t, 4> data;
+    };
+
+    template<class Domain>
+    struct rcu_cells_t {
+        static inline const std::string name = std::is_same_v<Domain, rcu::rcu_qsbr_domain> ? "rcu_qsbr" : "rcu";
+
+        using ptr_t = rcu::rcu_ptr<value, std::default_delete<value>, Domain>;
+
+        std::array<ptr_t, num_cells> cells;
+
+        rcu_cells_t() : cells{make_cells(std::make_index_sequence<num_cells>{})} {}
+        ~rcu_cells_t() {
+            for (auto&& cell : cells) {
+                cell.store(nullptr);
+            }
+            rcu::rcu_synchronize(default_domain());
+        }
+        static Domain& default_domain() noexcept {
+            return bench::rcu_impl_t<Domain>::default_domain();
+        }
+        template<std::size_t... I>
+        static auto make_cells(std::index_sequence<I...>) {
+            return std::array<ptr_t, num_cells>{ptr_t{new value{{I}}, default_domain()}...};
+        }
+
+        static void thread_online() {
+            bench::rcu_impl_t<Domain>::thread_online();
+        }
+        static void thread_offline() {
+            bench::rcu_impl_t<Domain>::thread_offline();
+        }
+        std::size_t read(const std::size_t i) {
+            if constexpr (std::is_same_v<Domain, rcu::rcu_qsbr_domain>) {
+                const auto v = cells[i].load()->data[0];
+                bench::rcu_impl_t<Domain>::quiescent_state();
+                return v;
+            }
+            else {
+                std::scoped_lock guard{default_domain()};
+                return cells[i].load()->data[0];
+            }
+        }
+        void write(const std::size_t i, const std::size_t v) {
+            cells[i].store(new value{{v}});
+            bench::rcu_impl_t<Domain>::quiescent_state();
+        }
+    };
+
+    struct atomic_shared_ptr_cells {
+        static inline const std::string name = "atomic_shared_ptr";
+
+        std::array<std::atomic<std::shared_ptr<const value>>, num_cells> cells;
+
+        atomic_shared_ptr_cells() {
+            for (std::size_t i = 0; i < num_cells; i++) {
+                cells[i].store(std::make_shared<const value>(value{{i}}), std::memory_order_relaxed);
+            }
+        }
+
+        static void thread_online() {}
+        static void thread_offline() {}
+        std::size_t read(const std::size_t i) {
+            return cells[i].load(std::memory_order_acquire)->data[0];
+        }
+        void write(const std::size_t i, const std::size_t v) {
+            cells[i].store(std::make_shared<const value>(value{{v}}), std::memory_order_release);
+        }
+    };
+
+    struct hazard_pointer_cells {
+        static inline const std::string name = "hazard_pointer";
+
+        std::array<std::atomic<value*>, num_cells> cells;
+
+        hazard_pointer_cells() {
+            for (std::size_t i = 0; i < num_cells; i++) {
+                cells[i].store(new value{{i}}, std::memory_order_relaxed);
+            }
+        }
+        ~hazard_pointer_cells() {
+            for (auto&& cell : cells) {
+                delete cell.load(std::memory_order_relaxed);
+            }
+            bench::hazard_pointers::drain();
+        }
+
+        static void thread_online() {}
+        static void thread_offline() {}
+        std::size_t read(const std::size_t i) {
+            const auto v = bench::hazard_pointers::protect(cells[i])->data[0];
+            bench::hazard_pointers::clear();
+            return v;
+        }
+        void write(const std::size_t i, const std::size_t v) {
+            bench::hazard_pointers::retire(cells[i].exchange(new value{{v}}, std::memory_order_seq_cst));
+        }
+    };
+}
+
+// range(0) is the writes per thousand operations
+template<class Cells>
+static void BM_retire_heavy(benchmark::State& state) {
+    static Cells* data;
+    const auto writes = static_cast<std::uint64_t>(state.range(0));
+    if (state.thread_index() == 0) {
+        state.SetLabel(Cells::name);
+        data = new Cells{};
+    }
+
+    bench::xorshift rng{static_cast<std::uint64_t>(state.thread_index()) * 0x9e3779b97f4a7c15ull + 1};
+    Cells::thread_online();
+    for ([[maybe_unused]] auto _ : state) {
+        const auto r = rng();
+        if (r % 1000 < writes)
+            data->write((r >> 10) % num_cells, r);
+        else
+            benchmark::DoNotOptimize(data->read((r >> 10) % num_cells));
+    }
+    Cells::thread_offline();
+
+    if (state.thread_index() == 0) {
+        if constexpr (requires { Cells::default_domain(); }) {
+            state.counters["pending"] = static_cast<double>(Cells::default_domain().stats().pending);
+        }
+        delete data;
+        data = nullptr;
+        state.counters["threads"] = benchmark::Counter(state.threads(), benchmark::Counter::kDefaults);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void retire_sweep(benchmark::internal::Benchmark* b) {
+    b->ArgName("writes_per_1000");
+    for (auto&& writes : {100, 500, 1000}) {
+        b->Arg(writes);
+    }
+    bench::thread_sweep(b);
+}
+
+BENCHMARK_TEMPLATE(BM_retire_heavy, rcu_cells_t<rcu::rcu_domain>)->Apply(retire_sweep);
+BENCHMARK_TEMPLATE(BM_retire_heavy, rcu_cells_t<rcu::rcu_qsbr_domain>)->Apply(retire_sweep);
+BENCHMARK_TEMPLATE(BM_retire_heavy, atomic_shared_ptr_cells)->Apply(retire_sweep);
+BENCHMARK_TEMPLATE(BM_retire_heavy, hazard_pointer_cells)->Apply(retire_sweep);
+
+BENCHMARK_MAIN();
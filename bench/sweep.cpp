@@ -0,0 +1,83 @@
+#include "bench.h"
+
+// Mixed read/write throughput and reader latency. Args are the writes per thousand operations, the number
+// of elements a reader sums inside its critical section and the number of elements in the container.
+template<class Impl>
+static void BM_mixed(benchmark::State& state) {
+    static constexpr std::size_t sample_every = 16;
+    static Impl* data;
+    static std::unique_ptr<bench::latency_recorder> latency;
+
+    const auto writes = static_cast<std::uint64_t>(state.range(0));
+    const auto size = static_cast<std::size_t>(state.range(2));
+    const auto len = std::min(static_cast<std::size_t>(state.range(1)), size);
+    if (state.thread_index() == 0) {
+        state.SetLabel(Impl::name);
+        data = new Impl{size};
+        latency = std::make_unique<bench::latency_recorder>(state.threads());
+    }
+
+    bench::xorshift rng{static_cast<std::uint64_t>(state.thread_index()) * 0x9e3779b97f4a7c15ull + 1};
+    std::vector<std::int64_t> samples;
+    std::size_t reads = 0;
+    Impl::thread_online();
+    for ([[maybe_unused]] auto _ : state) {
+        const auto r = rng();
+        if (r % 1000 < writes) {
+            data->write((r >> 10) % size, r);
+            continue;
+        }
+        const auto first = (r >> 10) % (size - len + 1);
+        if (++reads % sample_every == 0)
+            samples.push_back(bench::time_ns([&] {
+                benchmark::DoNotOptimize(data->read(first, len));
+            }));
+        else
+            benchmark::DoNotOptimize(data->read(first, len));
+    }
+    Impl::thread_offline();
+
+    latency->merge(samples);
+    if (state.thread_index() == 0) {
+        delete data;
+        data = nullptr;
+        latency->report(state, "read");
+        state.counters["threads"] = benchmark::Counter(state.threads(), benchmark::Counter::kDefaults);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void write_sweep(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"writes_per_1000", "cs_len", "size"});
+    for (auto&& writes : {0, 1, 10, 100, 250, 500}) {
+        b->Args({writes, 256, 10'000});
+    }
+    bench::thread_sweep(b);
+}
+static void critical_section_sweep(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"writes_per_1000", "cs_len", "size"});
+    for (auto&& len : {1, 16, 256, 4096, 65536}) {
+        b->Args({10, len, 1 << 16});
+    }
+    bench::thread_sweep(b);
+}
+static void size_sweep(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"writes_per_1000", "cs_len", "size"});
+    for (auto&& size : {1 << 10, 1 << 14, 1 << 18, 1 << 22}) {
+        b->Args({10, 256, size});
+    }
+    bench::thread_sweep(b);
+}
+
+#define MIXED_BENCHMARKS(Impl) \
+    BENCHMARK_TEMPLATE(BM_mixed, Impl)->Name("write_sweep/" + Impl::name)->Apply(write_sweep); \
+    BENCHMARK_TEMPLATE(BM_mixed, Impl)->Name("critical_section_sweep/" + Impl::name)->Apply(critical_section_sweep); \
+    BENCHMARK_TEMPLATE(BM_mixed, Impl)->Name("size_sweep/" + Impl::name)->Apply(size_sweep)
+
+MIXED_BENCHMARKS(bench::rcu_impl);
+MIXED_BENCHMARKS(bench::rcu_qsbr_impl);
+MIXED_BENCHMARKS(bench::shared_mutex_impl);
+MIXED_BENCHMARKS(bench::atomic_shared_ptr_impl);
+MIXED_BENCHMARKS(bench::hazard_pointer_impl);
+
+BENCHMARK_MAIN();
@@ -1,12 +1,19 @@
 #include <barrier>
 #include <deque>
+#include <filesystem>
 #include <iostream>
+#include <latch>
 #include <random>
 #include <ranges>
+#include <semaphore>
 #include <shared_mutex>
 
 #include "rcu.h"
+#include "rcu_async.h"
 #include "rcu_deque.h"
+#include "rcu_map.h"
+#include "rcu_scan.h"
+#include "rcu_unordered_map.h"
 #include <benchmark/benchmark.h>
 
 template <typename F>
@@ -24,13 +31,25 @@ bool get_true() {
     return ret;
 }
 
+template<class Container>
+Container* make_container() {
+    if constexpr (requires { typename Container::mapped_type; }) {
+        return new Container(std::ranges::views::iota(0ul, 10'000ul) | std::ranges::views::transform([](std::size_t i) {
+            return std::pair{i, i};
+        }));
+    }
+    else {
+        return new Container(std::ranges::views::iota(0ul, 10'000ul));
+    }
+}
+
 template<class Work>
 void benchmark_work(benchmark::State& state) {
     using Deque = std::remove_reference_t<typename lambda_traits<Work>::template arg<0>>;
 
     static Deque* data;
     if (state.thread_index() == 0) {
-        data = new Deque(std::ranges::views::iota(0ul, 10'000ul));
+        data = make_container<Deque>();
     }
 
     for ([[maybe_unused]] auto _ : state) {
@@ -75,7 +94,7 @@ static void BM_read_only(benchmark::State& state) {
         }
         })>(state);
 }
-BENCHMARK(BM_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+BENCHMARK(BM_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6)->Threads(8)->Threads(16)->Threads(32);
 
 static void BM_shared_mutex(benchmark::State& state) {
     if (state.thread_index() == 0) {
@@ -118,13 +137,11 @@ static void BM_rcu_read_only(benchmark::State& state) {
                 std::lock_guard guard(data._write_lock);
 
                 auto old = data.ref_span();
-                island** new_data = std::allocator<island*>{}.allocate(old.size());
+                island** new_data = rcu::pool_allocator<island*>{}.allocate(old.size());
                 std::ranges::copy(std::span{const_cast<island**>(old.data()), old.size()}, new_data);
                 std::ranges::shuffle(std::span{new_data, old.size()}, gen);
                 data._ref_block.store({new_data, data._ref_block.load(std::memory_order_acquire).size}, std::memory_order_release);
-                rcu::rcu_retire(const_cast<island**>(old.data()), [size = old.size()](island** p) {
-                    std::allocator<island*>{}.deallocate(p, size);
-                });
+                rcu::rcu_retire(const_cast<island**>(old.data()), rcu::pool_array_deleter<island*>{});
             }
             else {
                 auto lock = std::scoped_lock{rcu::rcu_default_domain()};
@@ -135,37 +152,697 @@ static void BM_rcu_read_only(benchmark::State& state) {
     })>(state);
 }
 
-BENCHMARK(BM_rcu_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+BENCHMARK(BM_rcu_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6)->Threads(8)->Threads(16)->Threads(32);
+
+using rcu_work = decltype([](rcu::deque<std::size_t>& data) {
+    std::mt19937 gen{get_true()};
+    for (auto&& i : std::ranges::views::iota(0, 10'000)) {
+        if ((i % 1000 == 0) & get_true()) [[unlikely]] {
+            using island = rcu::deque<std::size_t>::island;
+            std::lock_guard guard(data._write_lock);
+
+            auto old = data.ref_span();
+            island** new_data = rcu::pool_allocator<island*>{}.allocate(old.size());
+            std::ranges::copy(std::span{const_cast<island**>(old.data()), old.size()}, new_data);
+            std::ranges::shuffle(std::span{new_data, old.size()}, gen);
+            data._ref_block.store({new_data, data._ref_block.load(std::memory_order_acquire).size}, std::memory_order_release);
+            rcu::rcu_retire(const_cast<island**>(old.data()), rcu::pool_array_deleter<island*>{});
+        }
+        else {
+            auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+            auto view = data.view();
+            benchmark::DoNotOptimize(std::find(view.begin(), view.end(), 5000ul));
+        }
+    }
+});
+
+static void BM_rcu_scan_read_only(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_scan_read_only");
+    }
+    benchmark_work<decltype([](rcu::deque<std::size_t>& data) {
+        for ([[maybe_unused]] auto&& i : std::ranges::views::iota(0, 10'000)) {
+            auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+            auto view = data.view();
+            benchmark::DoNotOptimize(rcu::scan::find(view, 5000ul));
+        }
+    })>(state);
+}
+
+BENCHMARK(BM_rcu_scan_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6)->Threads(8)->Threads(16)->Threads(32);
 
 static void BM_rcu(benchmark::State& state) {
     if (state.thread_index() == 0) {
         state.SetLabel("rcu");
     }
-    benchmark_work<decltype([](rcu::deque<std::size_t>& data) {
-        std::mt19937 gen{get_true()};
-        for (auto&& i : std::ranges::views::iota(0, 10'000)) {
+    benchmark_work<rcu_work>(state);
+}
+
+BENCHMARK(BM_rcu)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_rcu_reclaimer(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_reclaimer");
+        rcu::rcu_default_domain().start_reclaimer();
+    }
+    benchmark_work<rcu_work>(state);
+    if (state.thread_index() == 0) {
+        rcu::rcu_default_domain().stop_reclaimer();
+        const auto stats = rcu::rcu_default_domain().stats();
+        state.counters["pending"] = static_cast<double>(stats.pending);
+        if constexpr (rcu::rcu_stats::enabled) {
+            state.counters["grace_periods"] = static_cast<double>(stats.grace_periods);
+            state.counters["gp_p99_ns"] = static_cast<double>(stats.grace_period.quantile(0.99).count());
+        }
+    }
+}
+
+BENCHMARK(BM_rcu_reclaimer)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+template<bool Writes>
+using rcu_qsbr_work = decltype([](rcu::deque<std::size_t>& data) {
+    auto& dom = rcu::rcu_qsbr_default_domain();
+    std::mt19937 gen{get_true()};
+    rcu::rcu_thread_online(dom);
+    for (auto&& i : std::ranges::views::iota(0, 10'000)) {
+        if ((i % 1000 == 0) & (get_true() == Writes)) [[unlikely]] {
+            using island = rcu::deque<std::size_t>::island;
+            std::lock_guard guard(data._write_lock);
+
+            auto old = data.ref_span();
+            island** new_data = rcu::pool_allocator<island*>{}.allocate(old.size());
+            std::ranges::copy(std::span{const_cast<island**>(old.data()), old.size()}, new_data);
+            std::ranges::shuffle(std::span{new_data, old.size()}, gen);
+            data._ref_block.store({new_data, data._ref_block.load(std::memory_order_acquire).size}, std::memory_order_release);
+            rcu::rcu_retire(const_cast<island**>(old.data()), rcu::pool_array_deleter<island*>{}, dom);
+        }
+        else {
+            auto lock = std::scoped_lock{dom};
+            auto view = data.view();
+            benchmark::DoNotOptimize(std::find(view.begin(), view.end(), 5000ul));
+        }
+        rcu::rcu_quiescent_state(dom);
+    }
+    rcu::rcu_thread_offline(dom);
+});
+
+static void BM_rcu_qsbr_read_only(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_qsbr_read_only");
+    }
+    benchmark_work<rcu_qsbr_work<false>>(state);
+}
+
+BENCHMARK(BM_rcu_qsbr_read_only)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6)->Threads(8)->Threads(16)->Threads(32);
+
+static void BM_rcu_qsbr(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_qsbr");
+    }
+    benchmark_work<rcu_qsbr_work<true>>(state);
+    if (state.thread_index() == 0) {
+        rcu::rcu_synchronize(rcu::rcu_qsbr_default_domain());
+    }
+}
+
+BENCHMARK(BM_rcu_qsbr)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_shared_mutex_unordered_map(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("shared_mutex_unordered_map");
+    }
+    benchmark_work<decltype([](rcu::shared_mutex_unordered_map<std::size_t, std::size_t>& data) {
+        for (auto&& i : std::ranges::views::iota(0ul, 10'000ul)) {
             if ((i % 1000 == 0) & get_true()) [[unlikely]] {
-                using island = rcu::deque<std::size_t>::island;
-                std::lock_guard guard(data._write_lock);
+                data.insert_or_assign(i, i + 1);
+            }
+            else {
+                benchmark::DoNotOptimize(data.get(i * 7 % 10'000));
+            }
+        }
+    })>(state);
+}
 
-                auto old = data.ref_span();
-                island** new_data = std::allocator<island*>{}.allocate(old.size());
-                std::ranges::copy(std::span{const_cast<island**>(old.data()), old.size()}, new_data);
-                std::ranges::shuffle(std::span{new_data, old.size()}, gen);
-                data._ref_block.store({new_data, data._ref_block.load(std::memory_order_acquire).size}, std::memory_order_release);
-                rcu::rcu_retire(const_cast<island**>(old.data()), [size = old.size()](island** p) {
-                    std::allocator<island*>{}.deallocate(p, size);
-                });
+BENCHMARK(BM_shared_mutex_unordered_map)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_rcu_unordered_map(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_unordered_map");
+    }
+    benchmark_work<decltype([](rcu::unordered_map<std::size_t, std::size_t>& data) {
+        for (auto&& i : std::ranges::views::iota(0ul, 10'000ul)) {
+            if ((i % 1000 == 0) & get_true()) [[unlikely]] {
+                data.insert_or_assign(i, i + 1);
             }
             else {
                 auto lock = std::scoped_lock{rcu::rcu_default_domain()};
-                auto view = data.view();
-                benchmark::DoNotOptimize(std::find(view.begin(), view.end(), 5000ul));
+                benchmark::DoNotOptimize(data.find(i * 7 % 10'000));
             }
         }
     })>(state);
 }
 
-BENCHMARK(BM_rcu)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+BENCHMARK(BM_rcu_unordered_map)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_shared_mutex_map_range(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("shared_mutex_map_range");
+    }
+    benchmark_work<decltype([](rcu::shared_mutex_map<std::size_t, std::size_t>& data) {
+        for (auto&& i : std::ranges::views::iota(0ul, 10'000ul)) {
+            if ((i % 1000 == 0) & get_true()) [[unlikely]] {
+                data.insert_or_assign(i, i + 1);
+            }
+            else {
+                std::shared_lock guard(data._lock);
+                const auto first = i * 7 % 10'000;
+                benchmark::DoNotOptimize(std::ranges::count_if(
+                    std::ranges::subrange(data._map.lower_bound(first), data._map.lower_bound(first + 100)),
+                    [](auto&& kv) { return kv.second % 2 == 0; }));
+            }
+        }
+    })>(state);
+}
+
+BENCHMARK(BM_shared_mutex_map_range)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_rcu_map_range(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        state.SetLabel("rcu_map_range");
+    }
+    benchmark_work<decltype([](rcu::map<std::size_t, std::size_t>& data) {
+        for (auto&& i : std::ranges::views::iota(0ul, 10'000ul)) {
+            if ((i % 1000 == 0) & get_true()) [[unlikely]] {
+                data.insert_or_assign(i, i + 1);
+            }
+            else {
+                auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+                const auto first = i * 7 % 10'000;
+                benchmark::DoNotOptimize(std::ranges::count_if(data.range(first, first + 100), [](auto&& kv) {
+                    return kv.second % 2 == 0;
+                }));
+            }
+        }
+    })>(state);
+}
+
+BENCHMARK(BM_rcu_map_range)->Threads(1)->Threads(2)->Threads(3)->Threads(4)->Threads(5)->Threads(6);
+
+static void BM_rcu_deque_set(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& i : std::ranges::views::iota(0ul, 64ul)) {
+            data.set(i * 151, i);
+        }
+    }
+    rcu::rcu_synchronize();
+}
+
+BENCHMARK(BM_rcu_deque_set);
+
+static void BM_rcu_deque_transaction(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        auto tx = data.begin_transaction();
+        for (auto&& i : std::ranges::views::iota(0ul, 64ul)) {
+            tx.set(i * 151, i);
+        }
+        tx.commit();
+    }
+    rcu::rcu_synchronize();
+}
+
+BENCHMARK(BM_rcu_deque_transaction);
+
+static void BM_rcu_deque_push_pop(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& i : std::ranges::views::iota(0ul, 1024ul)) {
+            data.push_back(i);
+        }
+        for ([[maybe_unused]] auto&& i : std::ranges::views::iota(0ul, 1024ul)) {
+            data.pop_back();
+        }
+    }
+}
+
+BENCHMARK(BM_rcu_deque_push_pop);
+
+// a sliding window of range(0) elements: every sample appended at the back drops the oldest at the front
+static void BM_rcu_deque_window(benchmark::State& state) {
+    const auto window = static_cast<std::size_t>(state.range(0));
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, window));
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& i : std::ranges::views::iota(0ul, 1024ul)) {
+            data.push_back(i);
+            data.pop_front();
+        }
+    }
+}
+
+BENCHMARK(BM_rcu_deque_window)->Arg(1 << 10)->Arg(1 << 20);
+
+// Opening range(0) elements saved by dump(): mapping the file only copies the pointer block and a partial
+// tail island, where building the deque from a range copies every element.
+static void BM_rcu_deque_map_file(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    const auto path = std::filesystem::temp_directory_path() / "rcu_deque_bench.bin";
+    rcu::deque<std::size_t>(std::ranges::views::iota(0ul, size)).dump(path);
+    for ([[maybe_unused]] auto _ : state) {
+        rcu::deque<std::size_t> data(rcu::map_file, path);
+        benchmark::DoNotOptimize(&data);
+    }
+    std::filesystem::remove(path);
+}
+
+BENCHMARK(BM_rcu_deque_map_file)->Arg(1 << 10)->Arg(1 << 20);
+
+static void BM_rcu_deque_from_range(benchmark::State& state) {
+    const auto size = static_cast<std::size_t>(state.range(0));
+    for ([[maybe_unused]] auto _ : state) {
+        rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, size));
+        benchmark::DoNotOptimize(&data);
+    }
+}
+
+BENCHMARK(BM_rcu_deque_from_range)->Arg(1 << 10)->Arg(1 << 20);
+
+// Every thread sets elements in its own island of a shared deque, so multi writer commits only conflict on
+// the pointer block. The retries counter is the share of commits that lost to another writer.
+template<class Writers>
+static void BM_rcu_deque_writers(benchmark::State& state) {
+    using deque_t = rcu::deque<std::size_t, rcu::rcu_domain, Writers>;
+    static deque_t* data;
+    static std::atomic<std::size_t> attempts;
+    if (state.thread_index() == 0) {
+        data = new deque_t(std::ranges::views::iota(0ul, 64 * deque_t::island_size));
+        attempts = 0;
+    }
+    const auto first = static_cast<std::size_t>(state.thread_index()) * deque_t::island_size;
+    std::size_t commits = 0;
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& i : std::ranges::views::iota(0ul, 64ul)) {
+            data->update([&](auto& tx) {
+                attempts.fetch_add(1, std::memory_order_relaxed);
+                tx.set(first + i, tx[first + i] + 1);
+            });
+            commits++;
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(commits));
+    if (state.thread_index() == 0) {
+        rcu::rcu_synchronize();
+        state.counters["retries"] = benchmark::Counter(static_cast<double>(attempts.load() - commits * state.threads()) / static_cast<double>(commits * state.threads()));
+        delete data;
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_deque_writers, rcu::single_writer)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_rcu_deque_writers, rcu::multi_writer)->ThreadRange(1, 16)->UseRealTime();
+
+static void BM_atomic_vector_push_back(benchmark::State& state) {
+    static rcu::atomic_vector<std::size_t>* data;
+    if (state.thread_index() == 0) {
+        data = new rcu::atomic_vector<std::size_t>{};
+    }
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& i : std::ranges::views::iota(0ul, 1024ul)) {
+            data->push_back(i);
+        }
+    }
+    if (state.thread_index() == 0) {
+        rcu::rcu_synchronize();
+        delete data;
+        data = nullptr;
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+}
+
+BENCHMARK(BM_atomic_vector_push_back)->Threads(1)->Threads(2)->Threads(4)->UseRealTime();
+
+static void BM_std_count(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        auto view = data.view();
+        benchmark::DoNotOptimize(std::count(view.begin(), view.end(), 5000ul));
+    }
+}
+
+BENCHMARK(BM_std_count);
+
+static void BM_scan_count(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::count(data.view(), 5000ul));
+    }
+}
+
+BENCHMARK(BM_scan_count);
+
+static void BM_scan_sum(benchmark::State& state) {
+    rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 10'000ul));
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::sum(data.view()));
+    }
+}
+
+BENCHMARK(BM_scan_sum);
+
+static rcu::deque<std::size_t>& large_deque() {
+    static rcu::deque<std::size_t> data(std::ranges::views::iota(0ul, 16'000'000ul));
+    return data;
+}
+
+static void BM_scan_find_large(benchmark::State& state) {
+    auto& data = large_deque();
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::find(data.view(), 15'000'000ul));
+    }
+}
+
+BENCHMARK(BM_scan_find_large)->Unit(benchmark::kMillisecond);
+
+static void BM_parallel_scan_find_large(benchmark::State& state) {
+    auto& data = large_deque();
+    rcu::scan::worker_pool pool{static_cast<std::size_t>(state.range(0)) - 1};
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::parallel_find(data.view(), 15'000'000ul, pool));
+    }
+}
+
+BENCHMARK(BM_parallel_scan_find_large)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_scan_sum_large(benchmark::State& state) {
+    auto& data = large_deque();
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::sum(data.view()));
+    }
+}
+
+BENCHMARK(BM_scan_sum_large)->Unit(benchmark::kMillisecond);
+
+static void BM_parallel_scan_sum_large(benchmark::State& state) {
+    auto& data = large_deque();
+    rcu::scan::worker_pool pool{static_cast<std::size_t>(state.range(0)) - 1};
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+        benchmark::DoNotOptimize(rcu::scan::parallel_reduce(data.view(), 0ul, std::plus<>{}, pool));
+    }
+}
+
+BENCHMARK(BM_parallel_scan_sum_large)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+struct rcu_block {
+    std::array<std::size_t, 8> data;
+};
+struct rcu_obj_block : rcu::rcu_obj_base<rcu_obj_block> {
+    std::array<std::size_t, 8> data;
+};
+
+template<class Block>
+static void BM_rcu_ptr_store(benchmark::State& state) {
+    rcu::rcu_ptr<Block> ptr{new Block{}};
+    for ([[maybe_unused]] auto _ : state) {
+        ptr.store(new Block{});
+    }
+    rcu::rcu_synchronize();
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_ptr_store, rcu_block);
+BENCHMARK_TEMPLATE(BM_rcu_ptr_store, rcu_obj_block);
+
+// An rcu_synchronize that has to wait for a reader holding its critical section for range(0) microseconds.
+// Time is the latency from the reader leaving to the writer returning, CPU is what the writer burnt waiting.
+static void BM_rcu_synchronize_wait(benchmark::State& state) {
+    const auto hold = std::chrono::microseconds{state.range(0)};
+    std::binary_semaphore start{0}, entered{0};
+    std::atomic<std::chrono::steady_clock::time_point> released{};
+    std::atomic<bool> done{false};
+    std::jthread reader{[&] {
+        while (true) {
+            start.acquire();
+            if (done.load(std::memory_order_relaxed))
+                return;
+            auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+            entered.release();
+            std::this_thread::sleep_for(hold);
+            released.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+        }
+    }};
+    for ([[maybe_unused]] auto _ : state) {
+        start.release();
+        entered.acquire();
+        rcu::rcu_synchronize();
+        const auto woken = std::chrono::steady_clock::now();
+        state.SetIterationTime(std::chrono::duration<double>(woken - released.load(std::memory_order_relaxed)).count());
+    }
+    done.store(true, std::memory_order_relaxed);
+    start.release();
+}
+
+BENCHMARK(BM_rcu_synchronize_wait)->Arg(50)->Arg(200)->Arg(1000)->Iterations(1000)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+static void spin_for(const std::chrono::microseconds duration) {
+    const auto until = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < until) {}
+}
+
+// A writer unpublishes a value, then does range(0) microseconds of unrelated work before it frees the old
+// value. Polled starts the grace period up front and only waits for whatever is left of it afterwards.
+template<bool Polled>
+static void BM_rcu_overlapped_grace_period(benchmark::State& state) {
+    const auto work = std::chrono::microseconds{state.range(0)};
+    std::jthread reader{[](const std::stop_token& stop) {
+        while (!stop.stop_requested()) {
+            auto lock = std::scoped_lock{rcu::rcu_default_domain()};
+            spin_for(std::chrono::microseconds{20});
+        }
+    }};
+    for ([[maybe_unused]] auto _ : state) {
+        if constexpr (Polled) {
+            const auto cookie = rcu::rcu_get_state();
+            spin_for(work);
+            rcu::rcu_cond_synchronize(cookie);
+        }
+        else {
+            spin_for(work);
+            rcu::rcu_synchronize();
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_overlapped_grace_period, false)->Arg(10)->Arg(50)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_rcu_overlapped_grace_period, true)->Arg(10)->Arg(50)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// Retires into a domain with a budget of range(0) objects while a reader keeps entering 200us critical
+// sections. The pending counter is the most garbage that was waiting at once.
+static void BM_rcu_garbage_budget(benchmark::State& state) {
+    rcu::rcu_domain dom;
+    dom.set_garbage_budget({.objects = static_cast<std::size_t>(state.range(0))});
+    std::jthread reader{[&dom](const std::stop_token& stop) {
+        while (!stop.stop_requested()) {
+            auto lock = std::scoped_lock{dom};
+            spin_for(std::chrono::microseconds{200});
+        }
+    }};
+    std::size_t max_pending = 0;
+    for ([[maybe_unused]] auto _ : state) {
+        for ([[maybe_unused]] auto&& i : std::ranges::views::iota(0, 1024)) {
+            rcu::rcu_retire(new rcu_block{}, std::default_delete<rcu_block>{}, dom);
+        }
+        max_pending = std::max<std::size_t>(max_pending, dom.stats().pending);
+    }
+    reader.request_stop();
+    reader.join();
+    rcu::rcu_synchronize(dom);
+    state.counters["pending"] = static_cast<double>(max_pending);
+}
+
+BENCHMARK(BM_rcu_garbage_budget)->Arg(1 << 10)->Arg(1 << 14)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+static void BM_rcu_poll_state(benchmark::State& state) {
+    const auto cookie = rcu::rcu_get_state();
+    rcu::rcu_cond_synchronize(cookie);
+    for ([[maybe_unused]] auto _ : state) {
+        benchmark::DoNotOptimize(rcu::rcu_poll_state(cookie));
+    }
+}
+
+BENCHMARK(BM_rcu_poll_state);
+
+// Threads retire into a domain on a simulated topology of range(0) nodes, thread i placed on node i, so a
+// single node machine exercises the per-node reader slots and garbage bins.
+static void BM_rcu_numa_retire(benchmark::State& state) {
+    static std::unique_ptr<rcu::rcu_domain> dom;
+    if (state.thread_index() == 0)
+        dom = std::make_unique<rcu::rcu_domain>(rcu::numa_topology::parse(std::to_string(state.range(0))));
+    rcu::set_numa_node(static_cast<std::size_t>(state.thread_index()));
+    for ([[maybe_unused]] auto _ : state) {
+        {
+            auto lock = std::scoped_lock{*dom};
+            benchmark::ClobberMemory();
+        }
+        rcu::rcu_retire(new rcu_block{}, std::default_delete<rcu_block>{}, *dom);
+    }
+    rcu::clear_numa_node();
+    if (state.thread_index() == 0) {
+        rcu::rcu_synchronize(*dom);
+        state.counters["nodes"] = static_cast<double>(dom->stats().nodes);
+    }
+}
+
+BENCHMARK(BM_rcu_numa_retire)->Arg(1)->Arg(2)->Arg(4)->Threads(1)->Threads(2)->Threads(4)->UseRealTime();
+
+// fire-and-forget coroutine for the async benchmarks
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() noexcept {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+static detached_task await_grace_period(rcu::rcu_domain& dom, std::latch& done) {
+    co_await rcu::rcu_synchronize_async(rcu::inline_executor{}, dom);
+    done.count_down();
+}
+
+// range(0) coroutines await a grace period at once; the generations counter is how many grace periods
+// served them per iteration.
+static void BM_rcu_synchronize_async(benchmark::State& state) {
+    rcu::rcu_domain dom;
+    const auto waiters = state.range(0);
+    const auto first = dom.stats().generation;
+    for ([[maybe_unused]] auto _ : state) {
+        std::latch done{waiters};
+        for ([[maybe_unused]] auto&& i : std::ranges::views::iota(decltype(waiters){0}, waiters)) {
+            await_grace_period(dom, done);
+        }
+        done.wait();
+    }
+    state.counters["generations"] = benchmark::Counter(static_cast<double>(dom.stats().generation - first), benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_rcu_synchronize_async)->Arg(1)->Arg(1000)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// resumes every coroutine on a thread of its own, and still reads its members once the coroutine may be gone
+struct thread_executor {
+    std::mutex* lock;
+    std::vector<std::jthread>* threads;
+    std::size_t* resumed;
+
+    void execute(const std::coroutine_handle<> h) const {
+        std::scoped_lock guard{*lock};
+        threads->emplace_back([h] { h.resume(); });
+        // the coroutine, and the awaiter it copied this executor from, may be gone by now
+        (*resumed)++;
+    }
+};
+
+static detached_task await_grace_period_on(thread_executor ex, rcu::rcu_domain& dom, std::latch& done) {
+    co_await rcu::rcu_synchronize_async(ex, dom);
+    done.count_down();
+}
+
+static void BM_rcu_synchronize_async_thread_executor(benchmark::State& state) {
+    rcu::rcu_domain dom;
+    const auto waiters = state.range(0);
+    std::size_t resumed = 0;
+    for ([[maybe_unused]] auto _ : state) {
+        std::mutex lock;
+        std::vector<std::jthread> threads;
+        std::latch done{waiters};
+        for ([[maybe_unused]] auto&& i : std::ranges::views::iota(decltype(waiters){0}, waiters)) {
+            await_grace_period_on({&lock, &threads, &resumed}, dom, done);
+        }
+        done.wait();
+        std::scoped_lock guard{lock};
+        threads.clear();
+    }
+    state.counters["resumed"] = benchmark::Counter(static_cast<double>(resumed), benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_rcu_synchronize_async_thread_executor)->Arg(1)->Arg(16)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// read-side critical sections of domains that count readers per thread and per CPU
+template<rcu::rcu_domain_type Domain>
+static void BM_rcu_read_lock(benchmark::State& state) {
+    static Domain dom;
+    for ([[maybe_unused]] auto _ : state) {
+        auto lock = std::scoped_lock{dom};
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_read_lock, rcu::rcu_domain)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_rcu_read_lock, rcu::rcu_percpu_domain)->ThreadRange(1, 16)->UseRealTime();
+
+// Grace periods while range(0) threads that have read from the domain sit idle: a memb domain scans a
+// reader slot per thread, a percpu one sums a counter per CPU.
+template<rcu::rcu_domain_type Domain>
+static void BM_rcu_synchronize_idle_readers(benchmark::State& state) {
+    Domain dom;
+    std::latch registered{state.range(0)};
+    std::latch done{1};
+    std::vector<std::jthread> readers;
+    for ([[maybe_unused]] auto&& i : std::ranges::views::iota(0l, state.range(0))) {
+        readers.emplace_back([&] {
+            {
+                auto lock = std::scoped_lock{dom};
+            }
+            registered.count_down();
+            done.wait();
+        });
+    }
+    registered.wait();
+    for ([[maybe_unused]] auto _ : state) {
+        rcu::rcu_synchronize(dom);
+    }
+    done.count_down();
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_synchronize_idle_readers, rcu::rcu_domain)->Arg(16)->Arg(1024)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_rcu_synchronize_idle_readers, rcu::rcu_percpu_domain)->Arg(16)->Arg(1024)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+// 64 pooled blocks retired a time, one rcu_retire() each or a single rcu_retire_bulk(); both fill typed
+// batches that are freed back to the pool in one call
+template<bool Bulk>
+static void BM_rcu_retire_pooled(benchmark::State& state) {
+    std::vector<rcu_block*> blocks(64);
+    for ([[maybe_unused]] auto _ : state) {
+        for (auto&& p : blocks) {
+            p = rcu::pool_new<rcu_block>();
+        }
+        if constexpr (Bulk) {
+            rcu::rcu_retire_bulk(std::span{blocks}, rcu::pool_deleter<rcu_block>{});
+        }
+        else {
+            for (auto* p : blocks) {
+                rcu::rcu_retire(p, rcu::pool_deleter<rcu_block>{});
+            }
+        }
+    }
+    rcu::rcu_synchronize();
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * blocks.size()));
+}
+
+BENCHMARK_TEMPLATE(BM_rcu_retire_pooled, false);
+BENCHMARK_TEMPLATE(BM_rcu_retire_pooled, true);
 
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK_MAIN();
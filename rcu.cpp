@@ -3,10 +3,434 @@
 //
 
 #include "rcu.h"
+#include "rcu_mmap.h"
+#include "rcu_percpu.h"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// restartable sequences need glibc 2.35 or later, which registers an rseq area for every thread
+#if defined(__linux__) && defined(__x86_64__) && __has_include(<sys/rseq.h>) && __has_include(<linux/membarrier.h>)
+#define RCU_PERCPU_RSEQ 1
+#include <linux/membarrier.h>
+#include <sys/rseq.h>
+#include <sys/syscall.h>
+#endif
 
 namespace rcu {
-    thread_local const std::size_t rcu_domain::key = std::hash<std::thread::id>{}(std::this_thread::get_id()) % num_ref_counts;
+    namespace {
+        std::mutex domains_lock;
+        // notified whenever a domain is unpinned, see thread_registry::~thread_registry()
+        std::condition_variable domain_unpinned;
+        std::uint64_t next_domain_id = 0;
+
+        // requires domains_lock, the id of every live domain and how many exiting threads have it pinned
+        std::unordered_map<std::uint64_t, std::size_t>& live_domains() {
+            static std::unordered_map<std::uint64_t, std::size_t> domains;
+            return domains;
+        }
+
+        constexpr std::size_t no_node = std::numeric_limits<std::size_t>::max();
+        // how long percpu_readers::wait() sleeps between polls at most
+        constexpr std::chrono::microseconds max_poll_interval{500};
+        thread_local std::size_t numa_node_override = no_node;
+
+        bool parse_number(std::string_view& s, std::size_t& n) {
+            const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+            if (ec != std::errc{})
+                return false;
+            s.remove_prefix(static_cast<std::size_t>(end - s.data()));
+            return true;
+        }
+        // a kernel style CPU list such as "0-3,8,10-11", sets cpu_nodes[cpu] = node for each CPU in it
+        bool parse_cpu_list(std::string_view list, const std::size_t node, std::vector<std::size_t>& cpu_nodes) {
+            while (!list.empty() && (list.back() == '\n' || list.back() == ' '))
+                list.remove_suffix(1);
+            while (!list.empty()) {
+                std::size_t first, last;
+                if (!parse_number(list, first))
+                    return false;
+                last = first;
+                if (list.starts_with('-')) {
+                    list.remove_prefix(1);
+                    if (!parse_number(list, last) || last < first)
+                        return false;
+                }
+                if (!list.empty()) {
+                    if (!list.starts_with(','))
+                        return false;
+                    list.remove_prefix(1);
+                }
+                if (cpu_nodes.size() <= last)
+                    cpu_nodes.resize(last + 1, 0);
+                std::fill(cpu_nodes.begin() + static_cast<std::ptrdiff_t>(first), cpu_nodes.begin() + static_cast<std::ptrdiff_t>(last) + 1, node);
+            }
+            return true;
+        }
+
+        // one more than the highest CPU id the system may ever bring online, ids may have gaps
+        std::uint32_t possible_cpus() {
+            std::size_t n = static_cast<std::size_t>(std::max(::sysconf(_SC_NPROCESSORS_CONF), 1L));
+            std::ifstream file{"/sys/devices/system/cpu/possible"};
+            std::string list;
+            std::vector<std::size_t> cpus;
+            if (std::getline(file, list) && parse_cpu_list(list, 0, cpus))
+                n = std::max(n, cpus.size());
+            return static_cast<std::uint32_t>(n);
+        }
+
+#ifdef RCU_PERCPU_RSEQ
+        bool init_rseq() noexcept {
+            return __rseq_size != 0 && syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+        }
+        // whether glibc registered rseq areas and the process may issue expedited membarriers
+        bool rseq_enabled() noexcept {
+            static const bool enabled = init_rseq();
+            return enabled;
+        }
+
+        // Adds 1 to the counter at base + 64 * cpu for the CPU the thread runs on. The kernel restarts the
+        // sequence from the top if the thread is preempted, migrated or signalled before the add commits, so a
+        // plain add never races with another thread on the same CPU. Returns false if the CPU is num_cpus or
+        // beyond, or the thread has no rseq area.
+        bool rseq_increment(std::atomic<std::uint64_t>* base, const std::uint32_t num_cpus) noexcept {
+            auto* area = static_cast<std::byte*>(__builtin_thread_pointer()) + __rseq_offset;
+        restart:
+            // the descriptor in __rseq_cs covers 1: to 2:, the abort handler at 4: is preceded by RSEQ_SIG
+            asm goto(
+                ".pushsection __rseq_cs, \"aw\"\n\t"
+                ".balign 32\n\t"
+                "3:\n\t"
+                ".long 0x0, 0x0\n\t"
+                ".quad 1f, (2f - 1f), 4f\n\t"
+                ".popsection\n\t"
+                ".pushsection __rseq_failure, \"ax\"\n\t"
+                ".byte 0x0f, 0xb9, 0x3d\n\t"
+                ".long 0x53053053\n\t"
+                "4:\n\t"
+                "jmp %l[aborted]\n\t"
+                ".popsection\n\t"
+                "leaq 3b(%%rip), %%rax\n\t"
+                "movq %%rax, %[rseq_cs]\n\t"
+                "1:\n\t"
+                "movl %[cpu_id], %%eax\n\t"
+                "cmpl %[num_cpus], %%eax\n\t"
+                "jae %l[out_of_range]\n\t"
+                "shlq $6, %%rax\n\t"
+                "incq (%[base], %%rax)\n\t"
+                "2:\n\t"
+                :
+                : [rseq_cs] "m"(*reinterpret_cast<std::uint64_t*>(area + offsetof(struct rseq, rseq_cs))),
+                  [cpu_id] "m"(*reinterpret_cast<std::uint32_t*>(area + offsetof(struct rseq, cpu_id))),
+                  [num_cpus] "r"(num_cpus), [base] "r"(base)
+                : "rax", "memory", "cc"
+                : aborted, out_of_range);
+            return true;
+        aborted:
+            goto restart;
+        out_of_range:
+            return false;
+        }
+#endif
+        // a full barrier on every running thread of the process, cheap for them and costly for the caller
+        void heavy_barrier() noexcept {
+#ifdef RCU_PERCPU_RSEQ
+            if (rseq_enabled()) {
+                syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+                return;
+            }
+#endif
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        // the readers' side of heavy_barrier(), which leaves them only the compiler's reordering to prevent
+        void light_barrier() noexcept {
+#ifdef RCU_PERCPU_RSEQ
+            if (rseq_enabled()) {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                return;
+            }
+#endif
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        std::size_t current_cpu() noexcept {
+#ifdef __linux__
+            if (const int cpu = sched_getcpu(); cpu >= 0)
+                return static_cast<std::size_t>(cpu);
+#endif
+            return 0;
+        }
+    }
+
+    thread_local thread_registry thread_registry::local;
+    std::atomic<std::uint64_t> thread_registry::num_unregistered{};
+
+    numa_topology::numa_topology(std::vector<std::size_t> cpu_nodes) :
+        cpu_nodes{std::move(cpu_nodes)}, nodes{this->cpu_nodes.empty() ? 1 : std::ranges::max(this->cpu_nodes) + 1} {}
+
+    numa_topology numa_topology::detect() {
+        namespace fs = std::filesystem;
+        std::vector<std::size_t> ids;
+        std::error_code ec;
+        for (auto&& entry : fs::directory_iterator{"/sys/devices/system/node", ec}) {
+            const auto filename = entry.path().filename().string();
+            std::string_view name = filename;
+            std::size_t id;
+            if (name.starts_with("node") && (name.remove_prefix(4), parse_number(name, id)) && name.empty())
+                ids.push_back(id);
+        }
+        if (ids.size() < 2)
+            return {};
+        // node ids may have gaps, the topology numbers them densely
+        std::ranges::sort(ids);
+        std::vector<std::size_t> cpu_nodes;
+        for (std::size_t node = 0; node < ids.size(); node++) {
+            std::ifstream file{"/sys/devices/system/node/node" + std::to_string(ids[node]) + "/cpulist"};
+            std::string list;
+            std::getline(file, list);
+            if (!parse_cpu_list(list, node, cpu_nodes))
+                return {};
+        }
+        return numa_topology{std::move(cpu_nodes)};
+    }
+
+    numa_topology numa_topology::parse(const std::string_view spec) {
+        if (spec.find_first_not_of("0123456789") == std::string_view::npos) {
+            auto s = spec;
+            std::size_t n;
+            if (!parse_number(s, n) || n < 2)
+                return {};
+            const std::size_t cpus = std::max(std::thread::hardware_concurrency(), 1u);
+            std::vector<std::size_t> cpu_nodes(std::max(cpus, n));
+            for (std::size_t cpu = 0; cpu < cpu_nodes.size(); cpu++) {
+                cpu_nodes[cpu] = cpu * n / cpu_nodes.size();
+            }
+            return numa_topology{std::move(cpu_nodes)};
+        }
+        std::vector<std::size_t> cpu_nodes;
+        std::size_t node = 0;
+        for (auto&& list : spec | std::views::split(';')) {
+            if (!parse_cpu_list(std::string_view{list}, node++, cpu_nodes))
+                return {};
+        }
+        return numa_topology{std::move(cpu_nodes)};
+    }
+
+    const numa_topology& numa_topology::system() {
+        static const numa_topology topology = [] {
+            if (const char* spec = std::getenv("RCU_NUMA_NODES"))
+                return parse(spec);
+            return detect();
+        }();
+        return topology;
+    }
+
+    std::size_t numa_topology::current_node() const noexcept {
+        if (numa_node_override != no_node)
+            return numa_node_override % nodes;
+#ifdef __linux__
+        if (const int cpu = sched_getcpu(); cpu >= 0)
+            return node_of_cpu(static_cast<std::size_t>(cpu));
+#endif
+        return 0;
+    }
+
+    void set_numa_node(const std::size_t node) noexcept {
+        numa_node_override = node;
+    }
+
+    void clear_numa_node() noexcept {
+        numa_node_override = no_node;
+    }
+
+    percpu_readers::percpu_readers() : num_cpus{possible_cpus()} {
+        cpus = std::make_unique<cpu_counts[]>(num_cpus);
+#ifdef RCU_PERCPU_RSEQ
+        // also registers for membarrier before the first reader relies on it
+        if (rseq_enabled())
+            fallback_cpus = std::make_unique<cpu_counts[]>(num_cpus);
+#endif
+    }
+
+    void percpu_readers::increment(const std::size_t counter, const std::memory_order order) noexcept {
+#ifdef RCU_PERCPU_RSEQ
+        if (rseq_enabled() && rseq_increment(&cpus[0].counts[counter], num_cpus)) [[likely]]
+            return;
+#endif
+        auto& counts = fallback_cpus ? fallback_cpus : cpus;
+        counts[current_cpu() % num_cpus].counts[counter].fetch_add(1, order);
+    }
+
+    std::size_t percpu_readers::lock() noexcept {
+        const auto p = phase.load(std::memory_order_relaxed);
+        increment(p, std::memory_order_relaxed);
+        // pairs with the barrier between the unlock and lock sums in active()
+        light_barrier();
+        return p;
+    }
+
+    void percpu_readers::unlock(const std::size_t p) noexcept {
+        // on the rseq path, the writer's barrier after the sums orders the critical section before this
+        increment(2 + p, std::memory_order_release);
+    }
+
+    std::uint64_t percpu_readers::sum(const std::size_t counter) const noexcept {
+        std::uint64_t n = 0;
+        for (std::uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+            n += cpus[cpu].counts[counter].load(std::memory_order_acquire);
+            if (fallback_cpus)
+                n += fallback_cpus[cpu].counts[counter].load(std::memory_order_acquire);
+        }
+        return n;
+    }
+
+    // Counts only grow, and the unlocks are summed first, so every unlock seen has its lock seen as well:
+    // equal sums mean that none of the locks seen is still without its unlock.
+    bool percpu_readers::active(const std::size_t p) const noexcept {
+        const auto unlocks = sum(2 + p);
+        heavy_barrier();
+        return sum(p) != unlocks;
+    }
+
+    bool percpu_readers::drain(const std::size_t p, const std::chrono::steady_clock::time_point deadline) const noexcept {
+        auto interval = std::chrono::microseconds{1};
+        while (active(p)) {
+            if (std::chrono::steady_clock::now() >= deadline)
+                return false;
+            std::this_thread::sleep_for(interval);
+            interval = std::min(interval * 2, max_poll_interval);
+        }
+        return true;
+    }
+
+    // As in SRCU: readers of the other phase are left over from earlier grace periods, or read the phase
+    // before the last flip and counted themselves after it. Once they are gone, flipping leaves readers of
+    // the current phase to drain, and no new ones join them but for a few that read the phase just before.
+    bool percpu_readers::wait(const std::size_t wanted, const std::size_t ticket, const std::chrono::steady_clock::time_point deadline) noexcept {
+        std::unique_lock guard{wait_lock, std::defer_lock};
+        if (deadline == std::chrono::steady_clock::time_point::max())
+            guard.lock();
+        else if (!guard.try_lock() && !guard.try_lock_until(deadline))
+            return false;
+        while (ended <= wanted) {
+            const auto current = phase.load(std::memory_order_relaxed);
+            if (!flipped) {
+                // orders the caller's unpublishing before the counts
+                heavy_barrier();
+                if (!drain(current ^ 1, deadline))
+                    return false;
+                started = ticket;
+                flipped = true;
+                phase.store(current ^ 1, std::memory_order_relaxed);
+                heavy_barrier();
+            }
+            else {
+                if (!drain(current ^ 1, deadline))
+                    return false;
+                // orders the readers' critical sections before whatever the caller frees
+                heavy_barrier();
+                flipped = false;
+                ended = started + 1;
+            }
+        }
+        return true;
+    }
+
+    std::size_t percpu_readers::readers() const noexcept {
+        const auto unlocks = sum(2) + sum(3);
+        const auto locks = sum(0) + sum(1);
+        return locks > unlocks ? static_cast<std::size_t>(locks - unlocks) : 0;
+    }
+
+    bool percpu_readers::uses_rseq() noexcept {
+#ifdef RCU_PERCPU_RSEQ
+        return rseq_enabled();
+#else
+        return false;
+#endif
+    }
+
+    mapped_file::mapped_file(const std::filesystem::path& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::system_error{errno, std::generic_category(), "open " + path.string()};
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error{err, std::generic_category(), "stat " + path.string()};
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        // an empty file has nothing to map, and mmap rejects a zero length
+        if (length != 0) {
+            addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error{err, std::generic_category(), "mmap " + path.string()};
+            }
+        }
+        // the mapping keeps the file alive
+        ::close(fd);
+    }
+
+    mapped_file::~mapped_file() {
+        if (length != 0)
+            ::munmap(addr, length);
+    }
+
+    thread_registry::~thread_registry() noexcept {
+        // Releasing a slot runs deleters, which may create or destroy domains, so rather than holding
+        // domains_lock throughout, each live domain is pinned while its slot is released, one at a time.
+        for (auto&& e : entries) {
+            {
+                std::scoped_lock guard{domains_lock};
+                const auto it = live_domains().find(e.domain_id);
+                if (it == live_domains().end())
+                    continue;
+                it->second++;
+            }
+            e.release(e.domain, e.slot);
+            {
+                std::scoped_lock guard{domains_lock};
+                live_domains().find(e.domain_id)->second--;
+            }
+            domain_unpinned.notify_all();
+        }
+    }
+
+    std::uint64_t thread_registry::register_domain() {
+        std::scoped_lock guard{domains_lock};
+        live_domains().emplace(next_domain_id, 0);
+        return next_domain_id++;
+    }
+
+    void thread_registry::unregister_domain(const std::uint64_t id) noexcept {
+        std::unique_lock guard{domains_lock};
+        domain_unpinned.wait(guard, [id] { return live_domains().find(id)->second == 0; });
+        live_domains().erase(id);
+        num_unregistered.fetch_add(1, std::memory_order_relaxed);
+    }
 
-    thread_local std::uint64_t rcu_domain::num_readers = 0;
-    thread_local std::atomic<std::size_t>* rcu_domain::counter = &rcu_default_domain().garbage[rcu_default_domain().generation.load(std::memory_order_acquire) % max_gens].ref_count()[key];
-}
\ No newline at end of file
+    void thread_registry::prune() noexcept {
+        std::scoped_lock guard{domains_lock};
+        entries.remove_if([](const entry& e) { return !live_domains().contains(e.domain_id); });
+        last = nullptr;
+    }
+}
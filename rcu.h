@@ -3,13 +3,25 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <forward_list>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <ranges>
+#include <span>
+#include <stop_token>
 #include <thread>
 #include <utility>
 
+#include "rcu_numa.h"
+#include "rcu_percpu.h"
+#include "rcu_pool.h"
+#include "rcu_stats.h"
+
 namespace rcu {
     struct deleter_t {
         template<class D>
@@ -74,7 +86,9 @@ namespace rcu {
             return *this;
         };
         ~deleter_t() noexcept {
-            std::invoke(vtable_ref.get().dealloc_ref, deleter_ptr);
+            // batches destroy every slot, used or not
+            if (!is_empty())
+                std::invoke(vtable_ref.get().dealloc_ref, deleter_ptr);
         }
         void operator()(void* p) {
             std::invoke(vtable_ref.get().invoke_ref, &deleter_ptr, p);
@@ -89,163 +103,1232 @@ namespace rcu {
         }
     };
 
-    class rcu_domain;
+    // intrusive retire linkage, see rcu_obj_base
+    struct rcu_node {
+        rcu_node* next{};
+        void (*reclaim)(rcu_node*) noexcept{};
+    };
+    // A thread's batch of pointers of one type retired with one stateless deleter, see rcu_retire(). Pointers
+    // are stored bare and the whole batch is reclaimed by a single call through its rcu_node, which runs D on
+    // each of them without a vtable, or once on all of them if D accepts a std::span<T* const>.
+    struct typed_batch_base : rcu_node {
+        // unique per T and D, see typed_batch::type_tag
+        const void* type;
+        std::size_t element_size;
+        std::size_t size{};
+    };
+    template<class T, class D, std::size_t Capacity>
+    struct typed_batch : typed_batch_base {
+        static constexpr std::size_t capacity = Capacity;
+        static constexpr char type_tag{};
+
+        std::array<T*, capacity> ptrs;
+
+        typed_batch() : typed_batch_base{{nullptr, &reclaim_batch}, &type_tag, sizeof(T)} {}
+
+        static void reclaim_batch(rcu_node* node) noexcept {
+            auto* self = static_cast<typed_batch*>(node);
+            const std::span<T* const> ps{self->ptrs.data(), self->size};
+            D d{};
+            if constexpr (std::is_invocable_v<D&, std::span<T* const>>) {
+                std::invoke(d, ps);
+            }
+            else {
+                for (auto* p : ps) {
+                    std::invoke(d, p);
+                }
+            }
+            pool_delete(self);
+        }
+    };
+    // Deleters that retire into typed batches rather than one deleter_t per pointer. The caller's deleter is
+    // dropped and a D{} made when the batch is reclaimed, under noexcept, so any other empty deleter keeps
+    // its own copy in a deleter_t.
+    template<class D>
+    concept stateless_deleter = std::is_empty_v<D> && std::is_nothrow_default_constructible_v<D>;
+
+    // intrusive link for a wait on a batched grace period, see basic_rcu_domain::defer()
+    struct rcu_waiter {
+        rcu_waiter* next{};
+        void (*resume)(rcu_waiter*) noexcept{};
+    };
+
+    // Each thread's reader state for every domain it has used. Domain ids are never reused, so entries of
+    // destroyed domains are skipped, and dropped by the next lookup that misses once any domain has been
+    // destroyed; the rest are released when the thread exits.
+    class thread_registry {
+    public:
+        struct entry {
+            std::uint64_t domain_id;
+            void* domain;
+            void* slot;
+            std::uint64_t num_readers;
+            void (*release)(void* domain, void* slot) noexcept;
+        };
+
+        thread_registry() = default;
+        thread_registry(const thread_registry&) = delete;
+        thread_registry& operator=(const thread_registry&) = delete;
+        ~thread_registry() noexcept;
+
+        static std::uint64_t register_domain();
+        // waits for exiting threads that are still releasing their slots of the domain
+        static void unregister_domain(std::uint64_t id) noexcept;
+
+        // the calling thread's entry for dom, created with a reader slot on first use
+        template<class Domain>
+        static entry& get(Domain& dom) {
+            auto& self = local;
+            if (self.last && self.last->domain_id == dom.id) [[likely]]
+                return *self.last;
+            return self.find(dom);
+        }
+        // as get(), but null instead of allocating if the calling thread hasn't used dom
+        template<class Domain>
+        static entry* try_get(Domain& dom) noexcept {
+            auto& self = local;
+            if (self.last && self.last->domain_id == dom.id) [[likely]]
+                return self.last;
+            for (auto&& e : self.entries) {
+                if (e.domain_id == dom.id)
+                    return self.last = &e;
+            }
+            return nullptr;
+        }
+
+    private:
+        thread_local static thread_registry local;
+        // bumped by unregister_domain()
+        static std::atomic<std::uint64_t> num_unregistered;
+
+        std::forward_list<entry> entries;
+        entry* last{};
+        // num_unregistered as of the last prune()
+        std::uint64_t pruned_at{};
+
+        // drops the entries of destroyed domains
+        void prune() noexcept;
+
+        template<class Domain>
+        entry& find(Domain& dom) {
+            if (const auto n = num_unregistered.load(std::memory_order_relaxed); n != pruned_at) [[unlikely]] {
+                pruned_at = n;
+                prune();
+            }
+            for (auto&& e : entries) {
+                if (e.domain_id == dom.id)
+                    return *(last = &e);
+            }
+            return *(last = &entries.emplace_front(dom.id, &dom, dom.acquire_slot(), 0, &Domain::release_erased));
+        }
+    };
+
+    // readers mark every critical section in their reader slot
+    struct rcu_memb_flavor {};
+    // read-side critical sections are free; readers announce quiescent states instead
+    struct rcu_qsbr_flavor {};
+    // readers count critical sections per CPU, see percpu_readers, so grace periods sum a counter per CPU
+    // instead of scanning a slot per thread; stall reports can't name these readers
+    struct rcu_percpu_flavor {};
+
+    template<class Flavor = rcu_memb_flavor, std::size_t MaxGens = 4, std::size_t PtrCapacity = 64>
+    class basic_rcu_domain;
+    using rcu_domain = basic_rcu_domain<>;
+    using rcu_qsbr_domain = basic_rcu_domain<rcu_qsbr_flavor>;
+    using rcu_percpu_domain = basic_rcu_domain<rcu_percpu_flavor>;
+
+    template<class T>
+    inline constexpr bool is_rcu_domain_v = false;
+    template<class Flavor, std::size_t MaxGens, std::size_t PtrCapacity>
+    inline constexpr bool is_rcu_domain_v<basic_rcu_domain<Flavor, MaxGens, PtrCapacity>> = true;
+    template<class T>
+    concept rcu_domain_type = is_rcu_domain_v<T>;
+
     rcu_domain& rcu_default_domain() noexcept;
+    rcu_qsbr_domain& rcu_qsbr_default_domain() noexcept;
+    rcu_percpu_domain& rcu_percpu_default_domain() noexcept;
 
-    class rcu_domain {
-        static constexpr std::size_t num_ref_counts = 4;
-        //static constexpr std::size_t gen_size = 16 * num_ref_counts;
-        static constexpr std::size_t max_gens = 4;
+    template<rcu_domain_type Domain = rcu_domain>
+    void rcu_synchronize(Domain& dom = rcu_default_domain()) noexcept;
+
+    // identifies a grace period started by basic_rcu_domain::get_state()
+    struct rcu_gp_state {
+        std::size_t generation;
+    };
+
+    // what retire() does while the garbage waiting for a grace period exceeds the domain's budget
+    enum class overflow_policy {
+        // waits for a grace period and reclaims, however long the readers take
+        block,
+        // as block, but gives up after the budget's timeout and keeps the garbage
+        block_for,
+        // wakes the background reclaimer and returns, blocks as block if no reclaimer is running
+        reclaimer,
+    };
+    // see basic_rcu_domain::set_garbage_budget(), bytes only count what was retired with a known size
+    struct garbage_budget {
+        std::size_t objects = std::numeric_limits<std::size_t>::max();
+        std::size_t bytes = std::numeric_limits<std::size_t>::max();
+        overflow_policy policy = overflow_policy::block;
+        std::chrono::milliseconds timeout{100};
+    };
+    // a reader holding back reclamation, see basic_rcu_domain::find_stalled_reader()
+    struct stalled_reader {
+        std::size_t slot;
+        std::thread::id thread;
+        std::size_t generation;
+        // since a writer first saw the reader in this generation
+        std::chrono::nanoseconds duration;
+    };
 
-        thread_local static const std::size_t key;
-        thread_local static std::uint64_t num_readers;
-        thread_local static std::atomic<std::size_t>* counter;
+    template<class Flavor, std::size_t MaxGens, std::size_t PtrCapacity>
+    class basic_rcu_domain {
+        static_assert(MaxGens >= 2 && PtrCapacity >= 1);
+        static constexpr bool is_qsbr = std::is_same_v<Flavor, rcu_qsbr_flavor>;
+        static constexpr bool is_percpu = std::is_same_v<Flavor, rcu_percpu_flavor>;
+        static constexpr std::size_t max_gens = MaxGens;
+        static constexpr std::size_t cache_line_size = 64;
 
         struct gen_t {
-            using ref_count_t = std::atomic<std::size_t>;
             using auto_ptr = std::pair<void*, deleter_t>;
-            static constexpr std::size_t num_ptrs_per_group = 64 / sizeof(auto_ptr);
-            using group = std::pair<ref_count_t, std::array<auto_ptr, num_ptrs_per_group>>;
-            static constexpr std::size_t ptr_capacity = num_ptrs_per_group * num_ref_counts;
-            using overflow_group = std::array<auto_ptr, ptr_capacity>;
+            static constexpr std::size_t ptr_capacity = PtrCapacity;
 
-            std::array<group, num_ref_counts> garbage_queue;
-            std::forward_list<overflow_group> overflow;
-            std::size_t first_overflow_group_size;
+            struct batch_t {
+                std::array<auto_ptr, ptr_capacity> ptrs;
+                std::size_t size{};
+                rcu_node* nodes{};
+                std::size_t num_nodes{};
+                // of the pointees retired with a known size, for stats
+                std::size_t bytes{};
 
-            auto ref_count() noexcept {
-                return garbage_queue | std::ranges::views::keys;
-            }
-            auto garbage() noexcept {
-                return garbage_queue | std::ranges::views::values | std::ranges::views::join;
-            }
+                [[nodiscard]] std::size_t count() const noexcept {
+                    return size + num_nodes;
+                }
+            };
+            using batch_list = std::forward_list<batch_t>;
 
+            batch_list batches;
             std::size_t size{};
+            std::size_t bytes{};
+            // the newest generation garbage was handed to this bin in
+            std::size_t generation{};
 
             ~gen_t() noexcept {
-                assert(try_synchronize());
-                clear();
+                reclaim(batches);
+            }
+            void splice(batch_list& list, const std::size_t gen) {
+                for (auto&& batch : list) {
+                    size += batch.count();
+                    bytes += batch.bytes;
+                }
+                batches.splice_after(batches.before_begin(), list);
+                generation = std::max(generation, gen);
+            }
+            batch_list take() noexcept {
+                size = 0;
+                bytes = 0;
+                return std::exchange(batches, {});
             }
-            void synchronize() noexcept {
-                for (auto&& i : ref_count()) {
-                    while (i.load(std::memory_order_acquire) != 0) {
-                        std::this_thread::yield();
+            static void reclaim(batch_list& list) {
+                for (auto&& batch : list) {
+                    for (auto&& [p, d] : batch.ptrs | std::ranges::views::take(batch.size)) {
+                        d(p);
+                        p = nullptr;
+                        d.clear();
+                    }
+                    for (auto* node = batch.nodes; node;) {
+                        auto* next = node->next;
+                        node->reclaim(node);
+                        node = next;
                     }
                 }
+                list.clear();
             }
-            bool try_synchronize() noexcept {
-                return std::ranges::all_of(ref_count(), [](auto&& count) {
-                    return count.load(std::memory_order_acquire) == 0;
-                });
+            [[nodiscard]] bool is_full() const {
+                return size >= ptr_capacity;
             }
-            void push(void* ptr, deleter_t&& d) {
-                if (size + 1 >= ptr_capacity) {
-                    if (overflow.empty() || first_overflow_group_size + 1 >= ptr_capacity) {
-                        overflow.emplace_front();
-                        first_overflow_group_size = 0;
+        };
+
+        using batch_list = typename gen_t::batch_list;
+
+        // writers poll a reader this many times before blocking on it
+        static constexpr int spin_limit = 256;
+        // upper bound on a blocked writer's sleep, covers the wakeup a reader misses when it checks waiters
+        // before its ctr store is visible, which is rare enough not to warrant a fence on the read side
+        static constexpr std::chrono::microseconds max_block{500};
+
+        struct node_t;
+
+        struct alignas(cache_line_size) reader_slot {
+            // memb: 0 outside of a read-side critical section, otherwise 1 + the generation it was entered in
+            // qsbr: 0 while offline, otherwise 1 + the generation of the last quiescent state
+            std::atomic<std::size_t> ctr{};
+            // writers blocked on this reader, on ctr's line so that checking it costs readers nothing
+            std::atomic<std::uint32_t> waiters{};
+            // percpu: the phase the thread's outermost critical section counted itself in, ctr stays 0
+            std::size_t phase{};
+            std::atomic<bool> in_use{true};
+            reader_slot* next{};
+
+            // the owning thread's partially filled retire batch, only contended by rcu_synchronize
+            alignas(cache_line_size) std::mutex retire_lock;
+            batch_list retired;
+            // its partially filled typed batches, one per type
+            rcu_node* typed{};
+
+            node_t* node{};
+            // order of creation across all nodes, and the thread the slot was last acquired by
+            std::size_t index{};
+            std::atomic<std::thread::id> owner{};
+            // requires stall_lock, when a writer first saw the reader at observed_ctr
+            std::size_t observed_ctr{};
+            std::chrono::steady_clock::time_point observed_at{};
+        };
+        // A NUMA node's reader slots and the garbage retired by its threads. Nodes are allocated by the first
+        // thread to use them, as are slots and retire batches, so with Linux's default local allocation all of
+        // it sits in the node's memory; writers only cross nodes to scan readers or to reclaim for
+        // rcu_synchronize.
+        struct alignas(cache_line_size) node_t {
+            std::atomic<reader_slot*> readers{};
+            alignas(cache_line_size) std::mutex garbage_lock;
+            std::array<gen_t, max_gens> garbage{};
+            // written under garbage_lock, read without it to check the domain's budget
+            std::atomic<std::size_t> pending{};
+            std::atomic<std::size_t> pending_bytes{};
+        };
+
+        const std::uint64_t id;
+        const numa_topology topology;
+
+        // read-mostly: shares a line with nothing the writers touch on retire
+        alignas(cache_line_size) std::atomic<std::size_t> generation;
+        // 1 + the newest generation known to have no readers left, 0 if none
+        std::atomic<std::size_t> completed;
+        // one per node of the topology, null until a thread on the node starts reading
+        std::unique_ptr<std::atomic<node_t*>[]> nodes;
+        std::atomic<std::size_t> num_slots;
+
+        // writers blocked in synchronize(), see wait_for()
+        std::mutex wait_lock;
+        std::condition_variable reader_left;
+
+        struct no_percpu_readers {};
+        [[no_unique_address]] std::conditional_t<is_percpu, percpu_readers, no_percpu_readers> percpu;
+
+        [[no_unique_address]] domain_stats<> counters;
+
+        // requires config_lock, see set_garbage_budget(); the limits are copied for flush() to read lock free
+        std::mutex config_lock;
+        garbage_budget budget{};
+        std::atomic<std::size_t> max_pending{std::numeric_limits<std::size_t>::max()};
+        std::atomic<std::size_t> max_pending_bytes{std::numeric_limits<std::size_t>::max()};
+        std::atomic<std::chrono::nanoseconds::rep> stall_threshold{std::chrono::nanoseconds{std::chrono::milliseconds{100}}.count()};
+        std::mutex stall_lock;
+        // shared with the writers calling it, so that reporting a stall copies a pointer rather than the handler
+        std::shared_ptr<const std::function<void(const stalled_reader&)>> stall_handler;
+
+        // opt-in background reclamation, see start_reclaimer()
+        std::atomic<bool> reclaiming{};
+        std::atomic<std::size_t> reclaim_backlog{};
+        std::chrono::milliseconds reclaim_interval{};
+        std::mutex reclaimer_lock;
+        std::condition_variable_any reclaimer_wakeup;
+        bool reclaim_requested{};
+        std::jthread reclaimer;
+
+        // waiters for the next batched grace period, see defer()
+        std::mutex waiter_lock;
+        std::condition_variable_any waiter_wakeup;
+        rcu_waiter* waiters{};
+        std::jthread waiter_thread;
+
+        [[nodiscard]] std::span<std::atomic<node_t*>> node_list() const noexcept {
+            return {nodes.get(), topology.num_nodes()};
+        }
+        node_t& local_node() {
+            auto& entry = nodes[topology.current_node()];
+            if (auto* node = entry.load(std::memory_order_acquire)) [[likely]]
+                return *node;
+            auto* node = new node_t{};
+            if (node_t* expected = nullptr; !entry.compare_exchange_strong(expected, node, std::memory_order_acq_rel)) {
+                delete node;
+                return *expected;
+            }
+            return *node;
+        }
+        // calls f with every node that has been used
+        template<class F>
+        void for_each_node(F&& f) {
+            for (auto&& entry : node_list()) {
+                if (auto* node = entry.load(std::memory_order_acquire))
+                    f(*node);
+            }
+        }
+        // whether f returns true for every reader slot, stops at the first that it doesn't
+        template<class F>
+        bool all_slots(F&& f) {
+            for (auto&& entry : node_list()) {
+                auto* node = entry.load(std::memory_order_acquire);
+                for (auto* slot = node ? node->readers.load(std::memory_order_acquire) : nullptr; slot; slot = slot->next) {
+                    if (!f(*slot))
+                        return false;
+                }
+            }
+            return true;
+        }
+        template<class F>
+        void for_each_slot(F&& f) {
+            all_slots([&](reader_slot& slot) {
+                f(slot);
+                return true;
+            });
+        }
+
+        // a slot on the calling thread's node, which its retired garbage goes to for as long as it holds it
+        reader_slot* acquire_slot() {
+            auto& node = local_node();
+            for (auto* slot = node.readers.load(std::memory_order_acquire); slot; slot = slot->next) {
+                bool expected = false;
+                if (!slot->in_use.load(std::memory_order_relaxed) &&
+                    slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    slot->owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+                    return slot;
+                }
+            }
+            auto* slot = new reader_slot{};
+            slot->node = &node;
+            slot->index = num_slots.fetch_add(1, std::memory_order_relaxed);
+            slot->owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            slot->next = node.readers.load(std::memory_order_relaxed);
+            while (!node.readers.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {}
+            return slot;
+        }
+        void release_slot(reader_slot* slot) noexcept {
+            if constexpr (is_qsbr)
+                publish(*slot, 0);
+            assert(slot->ctr.load(std::memory_order_relaxed) == 0);
+            flush(*slot);
+            slot->in_use.store(false, std::memory_order_release);
+        }
+        static void release_erased(void* dom, void* slot) noexcept {
+            static_cast<basic_rcu_domain*>(dom)->release_slot(static_cast<reader_slot*>(slot));
+        }
+        reader_slot& local_slot() {
+            return *static_cast<reader_slot*>(thread_registry::get(*this).slot);
+        }
+
+        // hands a thread's pending batch to the current generation, along with its typed batches
+        void flush(reader_slot& slot) {
+            batch_list list;
+            {
+                std::scoped_lock guard{slot.retire_lock};
+                while (slot.typed) {
+                    close_typed(slot, slot.typed);
+                }
+                list = std::exchange(slot.retired, {});
+            }
+            if (!list.empty())
+                flush(list, *slot.node);
+        }
+        // Hands a list of batches to the node's current generation, advancing the generation if its bin is
+        // full and reclaiming whatever the node has in the bin that has since completed. Returns whether the
+        // domain's pending garbage is over budget.
+        bool flush(batch_list& list, node_t& node) {
+            batch_list reclaimed;
+            bool wake_reclaimer = false;
+            {
+                std::scoped_lock guard{node.garbage_lock};
+                if constexpr (stats_enabled) {
+                    for (auto&& batch : list) {
+                        counters.on_retired(batch.count(), batch.bytes);
                     }
-                    overflow.front()[first_overflow_group_size] = {ptr, std::move(d)};
-                    first_overflow_group_size++;
+                }
+                // other nodes advance the generation without this lock, so nothing else orders this load
+                // after the retired pointers were unpublished; pairs with the fence in enter()
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto current_gen = generation.load(std::memory_order_relaxed);
+                if (reclaiming.load(std::memory_order_relaxed)) {
+                    wake_reclaimer = pending() >= reclaim_backlog.load(std::memory_order_relaxed);
                 }
                 else {
-                    garbage_queue[size / num_ptrs_per_group].second[size % num_ptrs_per_group] = {ptr, std::move(d)};
-                    size++;
+                    if (node.garbage[current_gen % max_gens].is_full() &&
+                        (current_gen + 1 < max_gens || try_complete(current_gen + 1 - max_gens)) &&
+                        generation.compare_exchange_strong(current_gen, current_gen + 1, std::memory_order_release, std::memory_order_relaxed)) {
+                        current_gen++;
+                        counters.on_advance();
+                    }
+                    // the bin may still hold garbage from max_gens generations ago
+                    if (auto& bin = node.garbage[current_gen % max_gens]; bin.generation != current_gen && is_complete(bin.generation))
+                        reclaimed = bin.take();
                 }
+                node.garbage[current_gen % max_gens].splice(list, current_gen);
+                update_pending(node);
             }
-            void clear() {
-                assert(try_synchronize());
-                for (auto&& [p, d] : garbage() | std::ranges::views::take(size)) {
-                    d(p);
-                    p = nullptr;
-                    d.clear();
-                }
-                for (auto &&[p, d]: overflow | std::ranges::views::join) {
-                    d(p);
-                    p = nullptr;
-                    d.clear();
+            reclaim(reclaimed);
+            if (wake_reclaimer)
+                request_reclaim();
+            return is_over_budget();
+        }
+        // requires the node's garbage_lock
+        static void update_pending(node_t& node) noexcept {
+            std::size_t size = 0;
+            std::size_t bytes = 0;
+            for (auto&& gen : node.garbage) {
+                size += gen.size;
+                bytes += gen.bytes;
+            }
+            node.pending.store(size, std::memory_order_relaxed);
+            node.pending_bytes.store(bytes, std::memory_order_relaxed);
+        }
+        [[nodiscard]] std::size_t pending() const noexcept {
+            std::size_t size = 0;
+            for (auto&& entry : node_list()) {
+                if (const auto* node = entry.load(std::memory_order_acquire))
+                    size += node->pending.load(std::memory_order_relaxed);
+            }
+            return size;
+        }
+        [[nodiscard]] bool is_over_budget() const noexcept {
+            if (pending() > max_pending.load(std::memory_order_relaxed))
+                return true;
+            std::size_t bytes = 0;
+            for (auto&& entry : node_list()) {
+                if (const auto* node = entry.load(std::memory_order_acquire))
+                    bytes += node->pending_bytes.load(std::memory_order_relaxed);
+            }
+            return bytes > max_pending_bytes.load(std::memory_order_relaxed);
+        }
+        // applies the budget's policy after a flush found the domain over budget
+        void relieve_pressure() {
+            if constexpr (is_qsbr) {
+                // waiting would make an online caller quiescent behind its back, freeing what it still holds
+                if (local_slot().ctr.load(std::memory_order_relaxed) != 0) {
+                    if (reclaiming.load(std::memory_order_relaxed))
+                        request_reclaim();
+                    return;
                 }
-                overflow.clear();
-                size = 0;
-                first_overflow_group_size = 0;
             }
-            [[nodiscard]] bool is_full() const {
-                return size + 1 >= ptr_capacity && first_overflow_group_size >= ptr_capacity;
+            else {
+                // a grace period can't end while the calling thread is inside a critical section
+                if (thread_registry::get(*this).num_readers != 0)
+                    return;
             }
-        };
+            bool hand_off;
+            auto deadline = std::chrono::steady_clock::time_point::max();
+            {
+                std::scoped_lock guard{config_lock};
+                hand_off = reclaiming.load(std::memory_order_relaxed) && budget.policy == overflow_policy::reclaimer;
+                if (budget.policy == overflow_policy::block_for)
+                    deadline = std::chrono::steady_clock::now() + budget.timeout;
+            }
+            if (hand_off)
+                request_reclaim();
+            else
+                synchronize_until(deadline);
+        }
+        void request_reclaim() {
+            {
+                std::scoped_lock guard{reclaimer_lock};
+                reclaim_requested = true;
+            }
+            reclaimer_wakeup.notify_one();
+        }
 
-        std::atomic<std::size_t> generation;
-        std::array<gen_t, max_gens> garbage;
+        void reclaim_loop(const std::stop_token token) {
+            std::unique_lock guard{reclaimer_lock};
+            while (!token.stop_requested()) {
+                reclaimer_wakeup.wait_for(guard, token, reclaim_interval, [this] { return reclaim_requested; });
+                reclaim_requested = false;
+                guard.unlock();
 
-        struct default_domain_tag_t {};
-        explicit rcu_domain(default_domain_tag_t) : generation{}, garbage{} {}
+                for_each_slot([this](reader_slot& slot) {
+                    flush(slot);
+                });
+                if (pending() != 0)
+                    rcu_synchronize(*this);
 
-        auto garbage_queue_view() noexcept {
-            return garbage | std::ranges::views::transform([](gen_t& gen) {
-                return gen.garbage();
-            });
+                guard.lock();
+            }
+        }
+        // Every batch of waiters queued while the previous one was served shares a single grace period, so
+        // a thousand waiters cost one scan of the readers. Drains the queue before stopping.
+        void wait_loop(const std::stop_token& token) {
+            std::unique_lock guard{waiter_lock};
+            while (waiter_wakeup.wait(guard, token, [this] { return waiters != nullptr; })) {
+                rcu_waiter* batch = nullptr;
+                for (auto* w = std::exchange(waiters, nullptr); w;) {
+                    auto* next = w->next;
+                    w->next = std::exchange(batch, w);
+                    w = next;
+                }
+                guard.unlock();
+                cond_synchronize(get_state());
+                // a resumed waiter may free itself
+                while (batch) {
+                    auto* w = std::exchange(batch, batch->next);
+                    w->resume(w);
+                }
+                guard.lock();
+            }
+        }
+
+        // true if the slot's reader entered at or before gen
+        [[nodiscard]] static bool holds(const reader_slot& slot, const std::size_t gen) noexcept {
+            const auto ctr = slot.ctr.load(std::memory_order_acquire);
+            return ctr != 0 && ctr - 1 <= gen;
+        }
+        // updates a reader's ctr, waking writers only if one is blocked on this reader
+        void publish(reader_slot& slot, const std::size_t ctr) noexcept {
+            slot.ctr.store(ctr, std::memory_order_release);
+            if (slot.waiters.load(std::memory_order_relaxed) != 0) [[unlikely]] {
+                { std::scoped_lock guard{wait_lock}; }
+                reader_left.notify_all();
+            }
+        }
+        // Spins briefly, then sleeps until the reader leaves every generation up to gen. Returns false if it
+        // is still there at deadline; once it has been waited on for the stall threshold, it is reported.
+        bool wait_for(reader_slot& slot, const std::size_t gen, const std::chrono::steady_clock::time_point deadline) noexcept {
+            for (int spins = 0; spins < spin_limit; spins++) {
+                if (!holds(slot, gen))
+                    return true;
+            }
+            slot.waiters.fetch_add(1, std::memory_order_seq_cst);
+            bool left = true;
+            {
+                const auto start = std::chrono::steady_clock::now();
+                observe(slot, start);
+                bool reported = false;
+                std::unique_lock guard{wait_lock};
+                while (holds(slot, gen)) {
+                    const auto now = std::chrono::steady_clock::now();
+                    if (now >= deadline) {
+                        left = false;
+                        break;
+                    }
+                    if (!reported && now - start >= std::chrono::nanoseconds{stall_threshold.load(std::memory_order_relaxed)}) {
+                        reported = true;
+                        guard.unlock();
+                        report_stall(slot);
+                        guard.lock();
+                        continue;
+                    }
+                    reader_left.wait_for(guard, std::min<std::chrono::nanoseconds>(max_block, deadline - now));
+                }
+            }
+            slot.waiters.fetch_sub(1, std::memory_order_relaxed);
+            return left;
+        }
+        bool synchronize(const std::size_t gen, const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) noexcept {
+            const auto start = counters.now();
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if constexpr (is_percpu) {
+                if (!percpu.wait(gen, generation.load(std::memory_order_acquire) - 1, deadline))
+                    return false;
+            }
+            else if (!all_slots([&](reader_slot& slot) { return wait_for(slot, gen, deadline); })) {
+                return false;
+            }
+            counters.on_grace_period(start);
+            return true;
         }
-        auto ref_count_view() noexcept {
-            return garbage | std::ranges::views::transform([](gen_t& gen) {
-                return gen.ref_count();
+        // Flushes every thread's batch, then waits for a grace period and reclaims everything retired
+        // before it. If a reader is still in the way at deadline, the garbage is left to a later one.
+        bool synchronize_until(const std::chrono::steady_clock::time_point deadline) noexcept {
+            for_each_slot([this](reader_slot& slot) {
+                flush(slot);
             });
+            batch_list reclaimed;
+            node_t* owner = nullptr;
+            for_each_node([&](node_t& node) {
+                std::scoped_lock guard{node.garbage_lock};
+                for (auto&& gen : node.garbage) {
+                    auto list = gen.take();
+                    if (!list.empty() && !owner)
+                        owner = &node;
+                    reclaimed.splice_after(reclaimed.before_begin(), list);
+                }
+                update_pending(node);
+            });
+            // everything taken was handed to a generation no newer than current_gen
+            const auto current_gen = generation.fetch_add(1, std::memory_order_acq_rel);
+            counters.on_advance();
+            const bool done = while_quiescent([&] {
+                if (!synchronize(current_gen, deadline))
+                    return false;
+                complete(current_gen);
+                return true;
+            });
+            if (!done) {
+                // the bin is only reclaimed once current_gen has completed, the garbage stays on one node
+                if (owner) {
+                    std::scoped_lock guard{owner->garbage_lock};
+                    owner->garbage[current_gen % max_gens].splice(reclaimed, current_gen);
+                    update_pending(*owner);
+                }
+                return false;
+            }
+            reclaim(reclaimed);
+            return true;
+        }
+
+        // requires stall_lock, dates the slot's reader from when a writer first saw it at its current ctr
+        stalled_reader observe_locked(reader_slot& slot, const std::size_t ctr, const std::chrono::steady_clock::time_point now) noexcept {
+            if (slot.observed_ctr != ctr) {
+                slot.observed_ctr = ctr;
+                slot.observed_at = now;
+            }
+            return stalled_reader{slot.index, slot.owner.load(std::memory_order_relaxed), ctr - 1, now - slot.observed_at};
+        }
+        void observe(reader_slot& slot, const std::chrono::steady_clock::time_point now) {
+            if (const auto ctr = slot.ctr.load(std::memory_order_acquire); ctr != 0) {
+                std::scoped_lock guard{stall_lock};
+                observe_locked(slot, ctr, now);
+            }
+        }
+        void report_stall(reader_slot& slot) noexcept {
+            const auto ctr = slot.ctr.load(std::memory_order_acquire);
+            if (ctr == 0)
+                return;
+            std::shared_ptr<const std::function<void(const stalled_reader&)>> handler;
+            stalled_reader reader;
+            {
+                std::scoped_lock guard{stall_lock};
+                reader = observe_locked(slot, ctr, std::chrono::steady_clock::now());
+                handler = stall_handler;
+            }
+            counters.on_stall(reader.generation);
+            if (!handler)
+                return;
+            // reports are best effort, a grace period must not fail because the handler did
+            try {
+                (*handler)(reader);
+            }
+            catch (...) {}
+        }
+        bool try_synchronize(const std::size_t gen) noexcept {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if constexpr (is_percpu)
+                return percpu.wait(gen, generation.load(std::memory_order_acquire) - 1, {});
+            return all_slots([gen](const reader_slot& slot) { return !holds(slot, gen); });
+        }
+
+        // runs the deleters of a list taken out of the generations
+        void reclaim(batch_list& list) noexcept {
+            if (list.empty())
+                return;
+            std::size_t count = 0;
+            if constexpr (stats_enabled) {
+                for (auto&& batch : list) {
+                    count += batch.count();
+                }
+            }
+            const auto start = counters.now();
+            gen_t::reclaim(list);
+            counters.on_reclaim(count, start);
+        }
+        // records that no reader of gen or older is left
+        void complete(const std::size_t gen) noexcept {
+            auto done = completed.load(std::memory_order_relaxed);
+            while (done < gen + 1 && !completed.compare_exchange_weak(done, gen + 1, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+        [[nodiscard]] bool is_complete(const std::size_t gen) const noexcept {
+            return gen < completed.load(std::memory_order_acquire);
+        }
+        bool try_complete(const std::size_t gen) noexcept {
+            if (is_complete(gen))
+                return true;
+            if (!try_synchronize(gen))
+                return false;
+            complete(gen);
+            return true;
+        }
+        // runs f() with the calling thread quiescent, so that a qsbr writer doesn't wait on itself
+        template<class F>
+        bool while_quiescent(F&& f) noexcept {
+            if constexpr (is_qsbr) {
+                // a thread that never used the domain is offline
+                auto* r = thread_registry::try_get(*this);
+                if (!r)
+                    return f();
+                auto& slot = *static_cast<reader_slot*>(r->slot);
+                const bool online = slot.ctr.load(std::memory_order_relaxed) != 0;
+                publish(slot, 0);
+                const bool result = f();
+                if (online)
+                    enter(slot);
+                return result;
+            }
+            else {
+                return f();
+            }
+        }
+
+        // marks the calling thread's slot as a reader of the current generation
+        void enter(reader_slot& slot) noexcept {
+            slot.ctr.store(generation.load(std::memory_order_acquire) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        // requires the slot's retire_lock
+        typename gen_t::batch_t& pending_batch(reader_slot& slot) {
+            if (slot.retired.empty()) {
+                slot.retired.emplace_front();
+                counters.on_batch_allocated();
+            }
+            return slot.retired.front();
+        }
+        // Requires the slot's retire_lock. Unlinks one of the slot's typed batches and adds it to the pending
+        // batch as a node that counts, for the budget and stats, as many pointers as it holds. A slot keeps a
+        // pending batch for as long as it has typed batches open, so that flushing never allocates.
+        void close_typed(reader_slot& slot, rcu_node* typed) noexcept {
+            auto** link = &slot.typed;
+            while (*link != typed) {
+                link = &(*link)->next;
+            }
+            *link = typed->next;
+            const auto* base = static_cast<typed_batch_base*>(typed);
+            assert(!slot.retired.empty());
+            auto& batch = slot.retired.front();
+            typed->next = std::exchange(batch.nodes, typed);
+            batch.num_nodes += base->size;
+            batch.bytes += base->size * base->element_size;
+        }
+        // push(slot) adds to the calling thread's pending batch under its retire_lock, which is handed to the
+        // generation once it holds ptr_capacity pointers
+        template<class Push>
+        void push_retired(Push&& push) {
+            auto& slot = local_slot();
+            batch_list full;
+            {
+                std::scoped_lock guard{slot.retire_lock};
+                push(slot);
+                if (!slot.retired.empty() && slot.retired.front().count() >= gen_t::ptr_capacity) {
+                    // open typed batches need a pending batch to close into, see close_typed()
+                    batch_list next;
+                    if (slot.typed) {
+                        next.emplace_front();
+                        counters.on_batch_allocated();
+                    }
+                    full = std::exchange(slot.retired, std::move(next));
+                }
+            }
+            if (!full.empty() && flush(full, *slot.node)) [[unlikely]]
+                relieve_pressure();
         }
 
     public:
-        rcu_domain() = delete;
-        rcu_domain(const rcu_domain&) = delete;
-        rcu_domain(rcu_domain&&) = delete;
-        rcu_domain& operator=(const rcu_domain&) = delete;
-        rcu_domain& operator=(rcu_domain&&) = delete;
-        ~rcu_domain() noexcept = default;
-
-        void lock() noexcept {
-            if (num_readers == 0)
-                counter = &garbage[generation.load(std::memory_order_acquire) % max_gens].ref_count()[key];
-            num_readers++;
-            counter->fetch_add(1, std::memory_order_release);
-        }
-        bool try_lock() noexcept {
+        // on the topology of numa_topology::system()
+        basic_rcu_domain() : basic_rcu_domain(numa_topology::system()) {}
+        // Keeps reader slots and garbage per node of the topology: threads retire into their own node, writers
+        // reclaim what their node retired and grace periods are detected by scanning each node's readers.
+        explicit basic_rcu_domain(numa_topology topology) :
+            id{thread_registry::register_domain()}, topology{std::move(topology)}, generation{}, completed{},
+            nodes{std::make_unique<std::atomic<node_t*>[]>(this->topology.num_nodes())}, num_slots{} {}
+        basic_rcu_domain(const basic_rcu_domain&) = delete;
+        basic_rcu_domain(basic_rcu_domain&&) = delete;
+        basic_rcu_domain& operator=(const basic_rcu_domain&) = delete;
+        basic_rcu_domain& operator=(basic_rcu_domain&&) = delete;
+        ~basic_rcu_domain() noexcept {
+            if (waiter_thread.joinable()) {
+                waiter_thread.request_stop();
+                waiter_thread.join();
+            }
+            stop_reclaimer();
+            thread_registry::unregister_domain(id);
+            for_each_node([](node_t& node) {
+                for (auto* slot = node.readers.load(std::memory_order_acquire); slot;) {
+                    gen_t::reclaim(slot->retired);
+                    for (auto* typed = slot->typed; typed;) {
+                        auto* next = typed->next;
+                        typed->reclaim(typed);
+                        typed = next;
+                    }
+                    delete std::exchange(slot, slot->next);
+                }
+                delete &node;
+            });
+        }
+
+        // the first call on a thread gives it a reader slot, which may throw std::bad_alloc
+        void lock() {
+            if constexpr (is_percpu) {
+                auto& r = thread_registry::get(*this);
+                if (r.num_readers++ == 0)
+                    static_cast<reader_slot*>(r.slot)->phase = percpu.lock();
+            }
+            else if constexpr (!is_qsbr) {
+                auto& r = thread_registry::get(*this);
+                if (r.num_readers++ == 0)
+                    enter(*static_cast<reader_slot*>(r.slot));
+            }
+        }
+        bool try_lock() {
             lock();
             return true;
         }
 
         void unlock() noexcept {
-            num_readers--;
-            counter->fetch_sub(1, std::memory_order_release);
+            if constexpr (is_percpu) {
+                auto& r = thread_registry::get(*this);
+                if (--r.num_readers == 0)
+                    percpu.unlock(static_cast<reader_slot*>(r.slot)->phase);
+            }
+            else if constexpr (!is_qsbr) {
+                auto& r = thread_registry::get(*this);
+                if (--r.num_readers == 0)
+                    publish(*static_cast<reader_slot*>(r.slot), 0);
+            }
+        }
+
+        // Threads start offline and may only read from a qsbr domain while online. An online thread holds
+        // up reclamation until it reports a quiescent state, i.e. a point where it holds no references.
+        void quiescent_state() requires is_qsbr {
+            auto& slot = local_slot();
+            const auto ctr = slot.ctr.load(std::memory_order_relaxed);
+            const auto current = generation.load(std::memory_order_acquire) + 1;
+            if (ctr == 0)
+                enter(slot);
+            else if (ctr != current)
+                publish(slot, current);
+        }
+        void thread_online() requires is_qsbr {
+            enter(local_slot());
+        }
+        void thread_offline() noexcept requires is_qsbr {
+            if (auto* r = thread_registry::try_get(*this))
+                publish(*static_cast<reader_slot*>(r->slot), 0);
+        }
+
+        // Polled grace periods. get_state() starts a grace period and returns a cookie for it: once every
+        // reader that was in a critical section at the time has left, poll_state() returns true and
+        // cond_synchronize() returns immediately. Writers can do other work in the meantime.
+        [[nodiscard]] rcu_gp_state get_state() noexcept {
+            // newer readers enter the next generation, so the cookie's grace period ends even under constant
+            // read load; garbage already in the next generation's bin is only reclaimed later than planned
+            const auto current_gen = generation.fetch_add(1, std::memory_order_acq_rel);
+            counters.on_advance();
+            return rcu_gp_state{current_gen};
+        }
+        [[nodiscard]] bool poll_state(const rcu_gp_state state) noexcept {
+            return is_complete(state.generation) || while_quiescent([&] {
+                return try_complete(state.generation);
+            });
+        }
+        void cond_synchronize(const rcu_gp_state state) noexcept {
+            if (is_complete(state.generation))
+                return;
+            while_quiescent([&] {
+                synchronize(state.generation);
+                complete(state.generation);
+                return true;
+            });
+        }
+
+        // bytes is the pointee's size, only used for stats
+        void retire(void* p, deleter_t&& d, const std::size_t bytes = 0) {
+            push_retired([&](reader_slot& slot) {
+                auto& batch = pending_batch(slot);
+                batch.ptrs[batch.size++] = {p, std::move(d)};
+                batch.bytes += bytes;
+            });
+        }
+        void retire(rcu_node* node, const std::size_t bytes = 0) {
+            push_retired([&](reader_slot& slot) {
+                auto& batch = pending_batch(slot);
+                node->next = std::exchange(batch.nodes, node);
+                batch.num_nodes++;
+                batch.bytes += bytes;
+            });
+        }
+        // Adds ps to the calling thread's typed batch for T and D under a single lock; every full typed batch
+        // joins the pending batch as one node.
+        template<class T, stateless_deleter D>
+        void retire(const std::span<T* const> ps) {
+            using batch_type = typed_batch<T, D, gen_t::ptr_capacity>;
+            push_retired([&](reader_slot& slot) {
+                auto* typed = slot.typed;
+                while (typed && static_cast<typed_batch_base*>(typed)->type != &batch_type::type_tag) {
+                    typed = typed->next;
+                }
+                for (auto* p : ps) {
+                    if (!typed) {
+                        pending_batch(slot);
+                        typed = pool_new<batch_type>();
+                        typed->next = std::exchange(slot.typed, typed);
+                    }
+                    auto* batch = static_cast<batch_type*>(typed);
+                    batch->ptrs[batch->size++] = p;
+                    if (batch->size == batch_type::capacity)
+                        close_typed(slot, std::exchange(typed, nullptr));
+                }
+            });
         }
 
-        void retire(void* p, deleter_t&& d) {
-            auto current_gen = generation.load(std::memory_order_acquire);
-            if (garbage[current_gen % max_gens].is_full() && garbage[(current_gen + 1) % max_gens].try_synchronize()) {
-                current_gen++;
-                generation.store(current_gen, std::memory_order_release);
-                garbage[current_gen % max_gens].clear();
+        // Calls w.resume(&w) from a domain thread once every reader in a critical section at the time of the
+        // call has left. Waiters queued close together are served by the same grace period. The waiter must
+        // stay alive until it is resumed, and the calling thread must not be in a read-side critical section
+        // of a memb or percpu domain while it waits or, on a qsbr domain, must keep reporting quiescent states.
+        void defer(rcu_waiter& w) {
+            {
+                std::scoped_lock guard{waiter_lock};
+                w.next = std::exchange(waiters, &w);
+                if (!waiter_thread.joinable()) {
+                    waiter_thread = std::jthread{[this](const std::stop_token& token) {
+                        wait_loop(token);
+                    }};
+                }
             }
-            garbage[current_gen % max_gens].push(p, std::move(d));
+            waiter_wakeup.notify_one();
+        }
+
+        // A snapshot of the domain's state. Generation, reader and pending garbage fields are always filled
+        // in; the counters and histograms stay zero unless built with RCU_STATS.
+        [[nodiscard]] rcu_stats stats() {
+            rcu_stats s;
+            s.generation = generation.load(std::memory_order_acquire);
+            s.oldest_reader_generation = s.generation;
+            s.nodes = topology.num_nodes();
+            if constexpr (is_percpu) {
+                s.readers = percpu.readers();
+            }
+            else {
+                for_each_slot([&](const reader_slot& slot) {
+                    if (const auto ctr = slot.ctr.load(std::memory_order_acquire); ctr != 0) {
+                        s.readers++;
+                        s.oldest_reader_generation = std::min(s.oldest_reader_generation, ctr - 1);
+                    }
+                });
+            }
+            for_each_node([&](node_t& node) {
+                std::scoped_lock guard{node.garbage_lock};
+                for (std::size_t age = 0; age < max_gens; age++) {
+                    const auto& gen = node.garbage[(s.generation + max_gens - age) % max_gens];
+                    s.pending += gen.size;
+                    s.pending_bytes += gen.bytes;
+                    if (age < s.pending_per_generation.size())
+                        s.pending_per_generation[age] += gen.size;
+                }
+            });
+            counters.fill(s);
+            return s;
+        }
+        // Caps the garbage waiting for a grace period. It is checked whenever a thread hands a full batch to
+        // the domain, so it can be exceeded by a batch per thread. A retire from inside a critical section never
+        // blocks, since the grace period it would wait for can't end; nor does one from an online qsbr thread,
+        // which only wakes the reclaimer, if any, as waiting would make it quiescent while it may still hold
+        // references. Such threads only block once offline.
+        void set_garbage_budget(const garbage_budget& b) {
+            std::scoped_lock guard{config_lock};
+            budget = b;
+            max_pending.store(b.objects, std::memory_order_relaxed);
+            max_pending_bytes.store(b.bytes, std::memory_order_relaxed);
+        }
+        // how long a writer waits on a single reader before reporting it as stalled
+        void set_stall_threshold(const std::chrono::nanoseconds threshold) noexcept {
+            stall_threshold.store(threshold.count(), std::memory_order_relaxed);
+        }
+        // Called from the waiting writer's thread whenever a reader is reported as stalled, in the middle of a
+        // noexcept grace period; whatever the handler throws is discarded.
+        void set_stall_handler(std::function<void(const stalled_reader&)> handler) {
+            auto shared = handler ? std::make_shared<const std::function<void(const stalled_reader&)>>(std::move(handler)) : nullptr;
+            std::scoped_lock guard{stall_lock};
+            stall_handler = std::move(shared);
         }
-        friend void rcu_synchronize(rcu_domain& dom) noexcept;
-        friend rcu_domain& rcu_default_domain() noexcept;
+        // The reader in the oldest generation that has already ended, provided a writer has seen it there for
+        // at least threshold. Durations start when a writer, or this function, first sees the reader, so
+        // calling it periodically keeps them close to the actual critical section.
+        [[nodiscard]] std::optional<stalled_reader> find_stalled_reader(const std::chrono::nanoseconds threshold = {}) {
+            const auto now = std::chrono::steady_clock::now();
+            const auto current = generation.load(std::memory_order_acquire);
+            std::optional<stalled_reader> oldest;
+            std::scoped_lock guard{stall_lock};
+            for_each_slot([&](reader_slot& slot) {
+                const auto ctr = slot.ctr.load(std::memory_order_acquire);
+                if (ctr == 0 || ctr - 1 >= current)
+                    return;
+                const auto reader = observe_locked(slot, ctr, now);
+                if (reader.duration >= threshold && (!oldest || reader.generation < oldest->generation))
+                    oldest = reader;
+            });
+            return oldest;
+        }
+
+        // Starts a thread that reclaims this domain's garbage every interval, or as soon as backlog
+        // retired pointers are pending. Until stop_reclaimer(), retire() never runs deleters itself.
+        void start_reclaimer(const std::chrono::milliseconds interval = std::chrono::milliseconds{10},
+                             const std::size_t backlog = 16 * gen_t::ptr_capacity) {
+            stop_reclaimer();
+            reclaim_backlog.store(backlog, std::memory_order_relaxed);
+            reclaim_interval = interval;
+            reclaiming.store(true, std::memory_order_relaxed);
+            reclaimer = std::jthread{[this](const std::stop_token token) {
+                reclaim_loop(token);
+            }};
+        }
+        void stop_reclaimer() noexcept {
+            if (reclaimer.joinable()) {
+                reclaimer.request_stop();
+                reclaimer.join();
+            }
+            reclaiming.store(false, std::memory_order_relaxed);
+        }
+        template<rcu_domain_type Domain>
+        friend void rcu_synchronize(Domain& dom) noexcept;
+        friend class thread_registry;
     };
-    template<class T, class D = std::default_delete<T>>
-    void rcu_retire(T* p, D d = D(), rcu_domain& dom = rcu_default_domain()) {
-        dom.retire(static_cast<void*>(p), deleter_t{std::type_identity<T>{}, std::move(d)});
+
+    // Stateless deleters, such as std::default_delete and pool_deleter, retire into a typed batch per T and D;
+    // any other, including an empty deleter that can't be made from nothing, goes through a type-erased
+    // deleter_t.
+    template<class T, class D = std::default_delete<T>, rcu_domain_type Domain = rcu_domain>
+    void rcu_retire(T* p, D d = D(), Domain& dom = rcu_default_domain()) {
+        if constexpr (stateless_deleter<D>)
+            dom.template retire<T, D>(std::span<T* const>{&p, 1});
+        else
+            dom.retire(static_cast<void*>(p), deleter_t{std::type_identity<T>{}, std::move(d)}, sizeof(T));
     }
+    // as rcu_retire() for every pointer of ps, but with a stateless deleter it takes the thread's retire
+    // lock only once
+    template<class T, class D = std::default_delete<T>, rcu_domain_type Domain = rcu_domain>
+    void rcu_retire_bulk(const std::span<T*> ps, D d = D(), Domain& dom = rcu_default_domain()) {
+        if constexpr (stateless_deleter<D>) {
+            dom.template retire<T, D>(std::span<T* const>{ps});
+        }
+        else {
+            for (auto* p : ps) {
+                rcu_retire(p, d, dom);
+            }
+        }
+    }
+    // invokes f once every reader that may have observed state prior to the call has finished
+    template<class F, rcu_domain_type Domain = rcu_domain>
+    void rcu_call(F&& f, Domain& dom = rcu_default_domain()) {
+        using fn_t = std::decay_t<F>;
+        rcu_retire(new fn_t{std::forward<F>(f)}, [](fn_t* p) {
+            std::invoke(*p);
+            delete p;
+        }, dom);
+    }
+    // Base for types that are retired through an intrusive link instead of a type-erased deleter_t,
+    // so retiring one neither allocates nor goes through a vtable.
+    template<class T, class D = std::default_delete<T>>
+    class rcu_obj_base : rcu_node {
+        [[no_unique_address]] D deleter;
+
+        static void reclaim_node(rcu_node* node) noexcept {
+            auto* self = static_cast<rcu_obj_base*>(node);
+            D d = std::move(self->deleter);
+            std::invoke(d, static_cast<T*>(self));
+        }
+
+    public:
+        template<rcu_domain_type Domain = rcu_domain>
+        void retire(D d = D(), Domain& dom = rcu_default_domain()) {
+            deleter = std::move(d);
+            reclaim = &reclaim_node;
+            dom.retire(static_cast<rcu_node*>(this), sizeof(T));
+        }
+
+    protected:
+        rcu_obj_base() = default;
+        rcu_obj_base(const rcu_obj_base&) = default;
+        rcu_obj_base(rcu_obj_base&&) = default;
+        rcu_obj_base& operator=(const rcu_obj_base&) = default;
+        rcu_obj_base& operator=(rcu_obj_base&&) = default;
+    };
+
+    // A pointer to an rcu-protected T. load() must happen inside a read-side critical section of the domain;
+    // every value replaced by store()/exchange()/compare_exchange() is retired through it.
+    template<class T, class D = std::default_delete<T>, rcu_domain_type Domain = rcu_domain>
+    class rcu_ptr {
+        std::atomic<T*> ptr;
+        Domain& dom;
+        [[no_unique_address]] D deleter;
+
+        void retire(T* p) {
+            if (!p)
+                return;
+            if constexpr (std::is_base_of_v<rcu_obj_base<T, D>, T>)
+                p->retire(deleter, dom);
+            else
+                rcu_retire(p, deleter, dom);
+        }
+
+    public:
+        explicit rcu_ptr(T* p = nullptr, Domain& dom = rcu_default_domain(), D d = D()) :
+            ptr{p}, dom{dom}, deleter{std::move(d)} {}
+        rcu_ptr(const rcu_ptr&) = delete;
+        rcu_ptr& operator=(const rcu_ptr&) = delete;
+        ~rcu_ptr() {
+            retire(ptr.load(std::memory_order_relaxed));
+        }
+
+        [[nodiscard]] T* load(const std::memory_order order = std::memory_order_acquire) const noexcept {
+            return ptr.load(order);
+        }
+        void store(T* desired) {
+            retire(ptr.exchange(desired, std::memory_order_acq_rel));
+        }
+        // the returned pointer is already retired, only dereference it inside a read-side critical section
+        T* exchange(T* desired) {
+            auto* old = ptr.exchange(desired, std::memory_order_acq_rel);
+            retire(old);
+            return old;
+        }
+        bool compare_exchange(T*& expected, T* desired) {
+            if (!ptr.compare_exchange_strong(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire))
+                return false;
+            retire(expected);
+            return true;
+        }
+    };
+
     inline rcu_domain& rcu_default_domain() noexcept {
-        static rcu_domain domain{rcu_domain::default_domain_tag_t{}};
+        static rcu_domain domain;
+        return domain;
+    }
+    inline rcu_qsbr_domain& rcu_qsbr_default_domain() noexcept {
+        static rcu_qsbr_domain domain;
+        return domain;
+    }
+    inline rcu_percpu_domain& rcu_percpu_default_domain() noexcept {
+        static rcu_percpu_domain domain;
         return domain;
     }
 
-    inline void rcu_synchronize(rcu_domain& dom = rcu_default_domain()) noexcept {
-        for (auto&& i : dom.garbage) {
-            i.synchronize();
-            i.clear();
-        }
+    template<rcu_domain_type Domain>
+    void rcu_synchronize(Domain& dom) noexcept {
+        dom.synchronize_until(std::chrono::steady_clock::time_point::max());
     }
 
-    inline void rcu_barrier(rcu_domain& dom = rcu_default_domain()) noexcept {
+    template<rcu_domain_type Domain = rcu_domain>
+    [[nodiscard]] rcu_gp_state rcu_get_state(Domain& dom = rcu_default_domain()) noexcept {
+        return dom.get_state();
+    }
+    template<rcu_domain_type Domain = rcu_domain>
+    [[nodiscard]] bool rcu_poll_state(const rcu_gp_state state, Domain& dom = rcu_default_domain()) noexcept {
+        return dom.poll_state(state);
+    }
+    template<rcu_domain_type Domain = rcu_domain>
+    void rcu_cond_synchronize(const rcu_gp_state state, Domain& dom = rcu_default_domain()) noexcept {
+        dom.cond_synchronize(state);
+    }
+
+    template<rcu_domain_type Domain = rcu_domain>
+    void rcu_barrier(Domain& dom = rcu_default_domain()) noexcept {
         rcu_synchronize(dom);
     }
 
+    inline void rcu_quiescent_state(rcu_qsbr_domain& dom = rcu_qsbr_default_domain()) {
+        dom.quiescent_state();
+    }
+    inline void rcu_thread_online(rcu_qsbr_domain& dom = rcu_qsbr_default_domain()) {
+        dom.thread_online();
+    }
+    inline void rcu_thread_offline(rcu_qsbr_domain& dom = rcu_qsbr_default_domain()) noexcept {
+        dom.thread_offline();
+    }
+
 }
 
 #endif //RCU_RCU_H
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef RCU_ASYNC_H
+#define RCU_ASYNC_H
+#include <concepts>
+#include <coroutine>
+#include <functional>
+#include <utility>
+
+#include "rcu.h"
+
+// Awaitable grace periods for coroutines. A suspended coroutine is queued on the domain with
+// basic_rcu_domain::defer(); the domain's waiter thread serves everything queued at once with a single grace
+// period and hands the coroutines to their executors, so no worker thread blocks in rcu_synchronize().
+namespace rcu {
+    // where a coroutine resumes once its grace period is over
+    template<class E>
+    concept rcu_executor = std::copy_constructible<E> && requires(E& ex, std::coroutine_handle<> h) {
+        ex.execute(h);
+    };
+
+    // resumes on the domain's waiter thread, which serves no other waiter until the coroutine suspends again
+    struct inline_executor {
+        void execute(const std::coroutine_handle<> h) const {
+            h.resume();
+        }
+    };
+
+    template<rcu_executor E, rcu_domain_type Domain>
+    class grace_period_awaiter : rcu_waiter {
+        Domain& dom;
+        [[no_unique_address]] E ex;
+        std::coroutine_handle<> handle;
+
+        // the awaiter and its executor live in the coroutine's frame, which may be gone before execute() returns
+        static void resume_waiter(rcu_waiter* w) noexcept {
+            auto* self = static_cast<grace_period_awaiter*>(w);
+            auto ex = self->ex;
+            const auto h = self->handle;
+            ex.execute(h);
+        }
+
+    public:
+        grace_period_awaiter(E ex, Domain& dom) : dom{dom}, ex{std::move(ex)} {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(const std::coroutine_handle<> h) {
+            handle = h;
+            resume = &resume_waiter;
+            dom.defer(*this);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // Runs d(p) once every reader that may still hold p has left, then resumes the awaiting coroutine.
+    template<class T, class D, rcu_executor E, rcu_domain_type Domain>
+    class retire_awaiter : rcu_waiter {
+        T* p;
+        [[no_unique_address]] D d;
+        Domain& dom;
+        [[no_unique_address]] E ex;
+        std::coroutine_handle<> handle;
+
+        static void resume_waiter(rcu_waiter* w) noexcept {
+            auto* self = static_cast<retire_awaiter*>(w);
+            std::invoke(self->d, self->p);
+            // as in grace_period_awaiter, the frame may be gone before execute() returns
+            auto ex = self->ex;
+            const auto h = self->handle;
+            ex.execute(h);
+        }
+
+    public:
+        retire_awaiter(T* p, D d, E ex, Domain& dom) : p{p}, d{std::move(d)}, dom{dom}, ex{std::move(ex)} {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+        void await_suspend(const std::coroutine_handle<> h) {
+            handle = h;
+            resume = &resume_waiter;
+            dom.defer(*this);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // co_await rcu_synchronize_async(ex) resumes on ex once every reader that was in a critical section
+    // at the time has left. Never await it inside a read-side critical section of the domain.
+    template<rcu_executor E = inline_executor, rcu_domain_type Domain = rcu_domain>
+    [[nodiscard]] grace_period_awaiter<E, Domain> rcu_synchronize_async(E ex = E{}, Domain& dom = rcu_default_domain()) {
+        return {std::move(ex), dom};
+    }
+    // co_await rcu_retire_async(p, d, ex) resumes on ex after d(p) has run, which happens once no reader
+    // can hold p; p must already be unpublished.
+    template<class T, class D = std::default_delete<T>, rcu_executor E = inline_executor, rcu_domain_type Domain = rcu_domain>
+    [[nodiscard]] retire_awaiter<T, D, E, Domain> rcu_retire_async(T* p, D d = D(), E ex = E{}, Domain& dom = rcu_default_domain()) {
+        return {p, std::move(d), std::move(ex), dom};
+    }
+}
+
+
+#endif //RCU_ASYNC_H
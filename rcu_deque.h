@@ -1,161 +1,505 @@
 #ifndef RCU_LINKED_LIST_H
 #define RCU_LINKED_LIST_H
+#include <algorithm>
 #include <cassert>
+#include <compare>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <shared_mutex>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include "rcu.h"
+#include "rcu_mmap.h"
+#include "rcu_pool.h"
 
 namespace rcu {
-    template<class T>
-    struct atomic_vector : std::ranges::range_adaptor_closure<atomic_vector<T>> {
-        struct ptr_size {
-            T* _ptr;
-            std::size_t _size;
-        };
+    // An append-only vector. Any number of threads append concurrently: each reserves an index, constructs
+    // its element in place and marks it ready, and whichever appender finds the element at _size ready
+    // advances _size over it, so no appender waits for another. Readers take wait-free snapshots with
+    // get_span() inside a read-side critical section of the vector's domain, and appenders enter one of
+    // their own while they touch the buffer. When the capacity runs out the buffer is copied into one twice
+    // its size and the old one is retired.
+    template<class T, rcu_domain_type Domain = rcu_domain>
+    struct atomic_vector {
+        static_assert(std::is_nothrow_move_constructible_v<T>);
+        static constexpr std::size_t min_capacity = 16;
 
-        std::atomic<ptr_size> _data;
+        struct buffer : rcu_obj_base<buffer> {
+            T* data;
+            const std::size_t capacity;
+            std::unique_ptr<std::atomic<bool>[]> ready;
+            // constructed elements, set when the buffer is retired or destroyed
+            std::size_t size{};
 
-        template<class R>
-        explicit atomic_vector(const R& range) : _data{{std::allocator<T>{}.allocate(range.size()), range.size()}} {
-            std::ranges::copy(range, _data.load(std::memory_order_acquire)._ptr);
-        }
-        atomic_vector() : _data{nullptr, 0} {}
-        atomic_vector(const atomic_vector& rhs) : _data{} {
-            const auto to_copy = rhs._data.load(std::memory_order_acquire);
-            _data.store({std::allocator<T>{}.allocate(to_copy._size), to_copy._size}, std::memory_order_release);
-            std::memcpy(_data.load(std::memory_order_acquire)._ptr, to_copy._ptr, sizeof(T) * to_copy._size);
+            explicit buffer(const std::size_t capacity) :
+                data{std::allocator<T>{}.allocate(capacity)}, capacity{capacity}, ready{new std::atomic<bool>[capacity]{}} {}
+            buffer(const buffer&) = delete;
+            buffer& operator=(const buffer&) = delete;
+            ~buffer() {
+                std::destroy_n(data, size);
+                std::allocator<T>{}.deallocate(data, capacity);
+            }
         };
-        atomic_vector(atomic_vector&& rhs)  noexcept : _data{std::exchange(rhs._data.load(std::memory_order_acquire), nullptr)} {}
-        atomic_vector& operator=(const atomic_vector& rhs) {
-            if (&rhs != this) {
-                const auto to_copy = rhs._data.load(std::memory_order_acquire);
-                auto old = _data.exchange({std::allocator<T>{}.allocate(to_copy._size), to_copy._size}, std::memory_order_release);
-                std::memcpy(_data.load(std::memory_order_acquire)._ptr, to_copy._ptr, sizeof(T) * to_copy._size);
-                std::allocator<T>{}.deallocate(old._ptr, old._size);
+
+        std::atomic<std::size_t> _reserved;
+        // elements [0, _size) are constructed and visible to readers
+        std::atomic<std::size_t> _size;
+        std::atomic<buffer*> _buffer;
+        std::mutex _grow_lock;
+        Domain& _domain;
+
+        explicit atomic_vector(Domain& dom = rcu_default_domain()) : atomic_vector(min_capacity, dom) {}
+        // starts out with room for capacity elements
+        explicit atomic_vector(const std::size_t capacity, Domain& dom = rcu_default_domain()) :
+            _reserved{}, _size{}, _buffer{new buffer{std::max(capacity, min_capacity)}}, _grow_lock{}, _domain{dom} {}
+        template<std::ranges::input_range R>
+        explicit atomic_vector(R&& rg, Domain& dom = rcu_default_domain()) :
+            atomic_vector(initial_capacity(rg), dom) {
+            for (auto&& i : rg) {
+                push_back(i);
             }
-            return *this;
         }
-        atomic_vector& operator=(atomic_vector&& rhs)  noexcept {
-            auto old = _data.exchange(rhs._data.exchange({nullptr, 0}, std::memory_order_release), std::memory_order_release);
-            std::allocator<T>{}.deallocate(old._ptr, old._size);
-            return *this;
-        }
-        ~atomic_vector() noexcept {
-            std::allocator<T>{}.deallocate(_data.load(std::memory_order_relaxed)._ptr, _data.load(std::memory_order_relaxed)._size);
+        atomic_vector(const atomic_vector&) = delete;
+        atomic_vector(atomic_vector&&) = delete;
+        atomic_vector& operator=(const atomic_vector&) = delete;
+        atomic_vector& operator=(atomic_vector&&) = delete;
+        ~atomic_vector() {
+            auto* buf = _buffer.load(std::memory_order_acquire);
+            buf->size = _size.load(std::memory_order_acquire);
+            delete buf;
         }
 
         [[nodiscard]] std::size_t size() const noexcept {
-            return _data.load(std::memory_order_acquire)._size;
+            return _size.load(std::memory_order_acquire);
         }
 
-        //NOT THREAD SAFE
-        void push_back(T val) {
-            const auto span = get_span();
-            auto new_data = std::allocator<T>{}.allocate(span.size() + 1);
-            std::ranges::copy(span, new_data);
-            new_data[span.size()] = val;
-            auto old = _data.exchange({new_data, span.size() + 1});
-            std::allocator<T>{}.deallocate(old._ptr, old._size);
+        // only valid inside a read-side critical section of the vector's domain
+        std::span<const T> get_span() const noexcept {
+            // every buffer published after an element holds a copy of it, so loading _size first is enough
+            const auto size = _size.load(std::memory_order_acquire);
+            return {_buffer.load(std::memory_order_acquire)->data, size};
         }
-        auto get_span() noexcept {
-            const auto data = _data.load(std::memory_order_acquire);
-            return std::span<T>(data._ptr, data._size);
+
+        // returns the new element's index
+        template<class... Args>
+        std::size_t emplace_back(Args&&... args) {
+            // constructed up front, so that once an index is reserved nothing can fail to fill it
+            T val(std::forward<Args>(args)...);
+            const auto i = _reserved.fetch_add(1, std::memory_order_relaxed);
+            // another appender may retire the buffer as soon as this one is published, or before it is loaded
+            std::scoped_lock read_guard{_domain};
+            auto* buf = _buffer.load(std::memory_order_acquire);
+            if (i >= buf->capacity) [[unlikely]]
+                buf = grow(i + 1);
+            ::new (static_cast<void*>(buf->data + i)) T(std::move(val));
+            buf->ready[i].store(true, std::memory_order_seq_cst);
+            publish();
+            return i;
+        }
+        std::size_t push_back(const T& val) {
+            return emplace_back(val);
+        }
+
+    private:
+        template<class R>
+        static std::size_t initial_capacity(R& rg) {
+            if constexpr (std::ranges::sized_range<R>)
+                return static_cast<std::size_t>(std::ranges::size(rg));
+            else
+                return 0;
+        }
+        // Requires a read-side critical section. Advances _size over every ready element. Marking an element
+        // ready and advancing _size up to it are both seq_cst, so whichever of the two appenders involved
+        // comes second sees the other's write.
+        void publish() noexcept {
+            auto size = _size.load(std::memory_order_seq_cst);
+            while (true) {
+                // an index past this buffer lives in a newer one, whose appender publishes it
+                const auto* buf = _buffer.load(std::memory_order_acquire);
+                if (size >= buf->capacity || !buf->ready[size].load(std::memory_order_seq_cst))
+                    return;
+                if (_size.compare_exchange_weak(size, size + 1, std::memory_order_seq_cst)) {
+                    size++;
+                    _size.notify_all();
+                }
+            }
+        }
+        void wait_for_size(const std::size_t size) const noexcept {
+            for (auto current = _size.load(std::memory_order_acquire); current < size; current = _size.load(std::memory_order_acquire)) {
+                _size.wait(current, std::memory_order_acquire);
+            }
+        }
+        // Requires a read-side critical section. Returns a buffer that holds at least capacity elements, only
+        // called once every index below the current capacity has been reserved. Elements are copied rather than moved, since readers may still
+        // be reading the old buffer; a throwing copy or allocation here terminates, as appenders that already
+        // reserved an index would otherwise wait forever.
+        buffer* grow(const std::size_t capacity) noexcept {
+            auto* old = _buffer.load(std::memory_order_acquire);
+            while (capacity > old->capacity) {
+                // waits without _grow_lock, the appenders it waits for may themselves be growing a stale buffer
+                wait_for_size(old->capacity);
+                std::scoped_lock guard{_grow_lock};
+                if (auto* current = _buffer.load(std::memory_order_relaxed); current != old) {
+                    old = current;
+                    continue;
+                }
+                auto* buf = new buffer{std::max(capacity, 2 * old->capacity)};
+                std::uninitialized_copy_n(old->data, old->capacity, buf->data);
+                for (std::size_t i = 0; i < old->capacity; i++) {
+                    buf->ready[i].store(true, std::memory_order_relaxed);
+                }
+                _buffer.store(buf, std::memory_order_release);
+                old->size = old->capacity;
+                old->retire({}, _domain);
+                return buf;
+            }
+            return old;
         }
     };
 
-    template<class T>
+    // deque writers serialize on a lock, appends and front drops edit the published block in place
+    struct single_writer {};
+    // deque writers build their edits against a snapshot and publish them with a compare_exchange, retrying
+    // on conflict; appends copy the tail island and pointer block like any other edit. Writers on a qsbr
+    // domain must be online.
+    struct multi_writer {};
+
+    template<class T, rcu_domain_type Domain = rcu_domain, class Writers = single_writer>
     struct deque {
+        static constexpr bool is_multi_writer = std::is_same_v<Writers, multi_writer>;
         static constexpr std::size_t island_size = 256;
         using island = std::array<T, island_size>;
 
         struct iter {
+            using iterator_concept = std::random_access_iterator_tag;
             using iterator_category = std::random_access_iterator_tag;
             using value_type = T;
             using difference_type = std::ptrdiff_t;
-            using pointer = T*;
-            using reference = T&;
+            using pointer = const T*;
+            using reference = const T&;
 
-            const island* const * data;
-            std::size_t index;
-            auto operator++(int) {
+            const island* const * data{};
+            std::size_t index{};
+            auto operator++(int) noexcept {
                 auto tmp = *this;
                 operator++();
                 return tmp;
             }
-            auto operator--(int) {
+            auto operator--(int) noexcept {
                 auto tmp = *this;
                 operator--();
                 return tmp;
             }
 
-            auto& operator++() {
+            auto& operator++() noexcept {
                 index++;
                 return *this;
             }
-            auto& operator--() {
+            auto& operator--() noexcept {
                 index--;
                 return *this;
             }
-            const value_type& operator*() {
+            auto& operator+=(const difference_type n) noexcept {
+                index += n;
+                return *this;
+            }
+            auto& operator-=(const difference_type n) noexcept {
+                index -= n;
+                return *this;
+            }
+            const value_type& operator*() const noexcept {
                 return (*(data[index / island_size]))[index % island_size];
             }
-            const value_type* operator->() {
+            const value_type* operator->() const noexcept {
                 return &**this;
             }
-            auto& operator[](const std::size_t pos) {
-                return *(iter{data, index + pos});
+            const value_type& operator[](const difference_type pos) const noexcept {
+                return *(*this + pos);
             }
-            friend difference_type operator-(const iter& lhs, const iter& rhs) {
-                return lhs.index - rhs.index;
+            friend iter operator+(iter it, const difference_type n) noexcept {
+                return it += n;
+            }
+            friend iter operator+(const difference_type n, iter it) noexcept {
+                return it += n;
+            }
+            friend iter operator-(iter it, const difference_type n) noexcept {
+                return it -= n;
+            }
+            friend difference_type operator-(const iter& lhs, const iter& rhs) noexcept {
+                return static_cast<difference_type>(lhs.index) - static_cast<difference_type>(rhs.index);
+            }
+            bool operator==(const iter& rhs) const noexcept {
+                return index == rhs.index;
+            }
+            auto operator<=>(const iter& rhs) const noexcept {
+                return index <=> rhs.index;
             }
-            bool operator==(const iter& rhs) const noexcept = default;
-            bool operator!=(const iter& rhs) const noexcept = default;
         };
+        // a snapshot of the deque, only valid inside the read-side critical section it was created in
         struct view_t : std::ranges::view_interface<view_t> {
             std::span<const island* const> data;
-            explicit view_t(std::span<const island* const>  data) : data(data) {}
+            std::size_t count;
+            // position of the first element in data[0]
+            std::size_t first{};
+            explicit view_t(std::span<const island* const>  data, std::size_t count, std::size_t first = 0) : data(data), count(count), first(first) {}
             view_t() = default;
 
             auto begin() const noexcept {
-                return iter{data.data(), 0};
+                return iter{data.data(), first};
             }
             auto end() const noexcept {
-                return iter{data.data(), island_size * size()};
+                return iter{data.data(), first + count};
             }
             auto size() const noexcept {
-                return island_size * data.size();
+                return count;
+            }
+            // the snapshot as a random access range of contiguous spans, one per island
+            auto segments() const noexcept {
+                return std::ranges::views::iota(std::size_t{0}, data.size()) | std::ranges::views::transform([data = data, count = count, first = first](const std::size_t i) {
+                    const auto begin = i == 0 ? first : 0;
+                    const auto end = std::min(island_size, first + count - i * island_size);
+                    return std::span<const T>{data[i]->data() + begin, end - begin};
+                });
+            }
+            // the index of segment i's first element in the view
+            [[nodiscard]] std::size_t segment_start(const std::size_t i) const noexcept {
+                return i == 0 ? 0 : i * island_size - first;
             }
         };
 
+        // Packed into two words so that it stays lock free. Dropping elements at the front only moves front,
+        // so the slots before its island hold retired islands until the block is next reallocated.
         struct ref_block_t {
             const island* const * ptr;
-            std::size_t size;
+            std::size_t size : 40;
+            // index of the first element counted from the start of ptr[0]
+            std::size_t front : 24 {};
+        };
+        static constexpr std::size_t max_front = (std::size_t{1} << 24) - 1;
+        static_assert(island_size <= max_front);
+        static constexpr std::size_t num_islands(const std::size_t size) noexcept {
+            return (size + island_size - 1) / island_size;
+        }
+
+        // Files that islands are mapped from, see remap(). Islands inside one of them belong to the mapping
+        // rather than the island pool. While a remap publishes its block, both its file and the one being
+        // replaced are listed.
+        struct mappings_t {
+            const mapped_file* current;
+            const mapped_file* previous;
+
+            [[nodiscard]] bool contains(const void* p) const noexcept {
+                return (current && current->contains(p)) || (previous && previous->contains(p));
+            }
+        };
+
+        // Copy-on-write edits against the latest snapshot, published as a single new ref_block_t by commit().
+        // Every island is copied at most once per transaction. Single writer transactions hold _write_lock
+        // from start to commit; multi writer ones hold a read-side critical section instead, so that the
+        // snapshot's islands stay alive while they are copied, and commit only if no other writer
+        // published in between.
+        class transaction {
+            deque& _deque;
+            std::unique_lock<std::mutex> _guard;
+            std::unique_lock<Domain> _read_guard;
+            ref_block_t _base;
+            // loaded after _base, so that it knows every file the snapshot's islands may be mapped from
+            const mappings_t* _maps;
+            std::vector<const island*> _block;
+            std::vector<bool> _owned;
+            std::vector<const island*> _replaced;
+            std::size_t _size;
+            // position of the first element in _block[0]
+            std::size_t _front;
+
+            island& mutable_island(const std::size_t i) {
+                if (!_owned[i]) {
+                    _replaced.push_back(_block[i]);
+                    _block[i] = pool_new<island>(*_block[i]);
+                    _owned[i] = true;
+                }
+                return *const_cast<island*>(_block[i]);
+            }
+            [[nodiscard]] bool is_open() const noexcept {
+                return _guard.owns_lock() || _read_guard.owns_lock();
+            }
+            // hands the islands this transaction allocated back to the pool, none of them were published
+            void discard() noexcept {
+                for (auto&& [p, owned] : std::ranges::views::zip(_block, _owned)) {
+                    if (owned)
+                        pool_delete(p);
+                }
+            }
+
+        public:
+            explicit transaction(deque& dq) : _deque{dq} {
+                if constexpr (is_multi_writer)
+                    _read_guard = std::unique_lock{dq._domain};
+                else
+                    _guard = std::unique_lock{dq._write_lock};
+                _base = dq._ref_block.load(std::memory_order_acquire);
+                _maps = dq._mappings.load(std::memory_order_acquire);
+                _size = _base.size;
+                _front = _base.front % island_size;
+                const auto old = live_islands(_base);
+                _block.assign(old.begin(), old.end());
+                _owned.assign(old.size(), false);
+            }
+            transaction(const transaction&) = delete;
+            transaction& operator=(const transaction&) = delete;
+            ~transaction() {
+                if (is_open())
+                    discard();
+            }
+
+            [[nodiscard]] std::size_t size() const noexcept {
+                return _size;
+            }
+            const T& operator[](const std::size_t pos) const noexcept {
+                const auto p = _front + pos;
+                return (*_block[p / island_size])[p % island_size];
+            }
+
+            void push_back(const T& val) {
+                const auto p = _front + _size;
+                if (p % island_size == 0) {
+                    _block.push_back(pool_new<island>());
+                    _owned.push_back(true);
+                }
+                mutable_island(p / island_size)[p % island_size] = val;
+                _size++;
+            }
+            template<class R>
+            void append_range(R&& rg) {
+                for (auto&& i : rg) {
+                    push_back(i);
+                }
+            }
+            void set(const std::size_t pos, const T& val) {
+                assert(pos < _size);
+                const auto p = _front + pos;
+                mutable_island(p / island_size)[p % island_size] = val;
+            }
+            void pop_back() {
+                assert(_size != 0);
+                _size--;
+                if ((_front + _size) % island_size == 0) {
+                    if (_owned.back())
+                        pool_delete(_block.back());
+                    else
+                        _replaced.push_back(_block.back());
+                    _block.pop_back();
+                    _owned.pop_back();
+                }
+            }
+            void drop_front(const std::size_t n) {
+                assert(n <= _size);
+                _size -= n;
+                _front += n;
+                const auto dropped = _front / island_size;
+                for (std::size_t i = 0; i < dropped; i++) {
+                    if (_owned[i])
+                        pool_delete(_block[i]);
+                    else
+                        _replaced.push_back(_block[i]);
+                }
+                _block.erase(_block.begin(), _block.begin() + static_cast<std::ptrdiff_t>(dropped));
+                _owned.erase(_owned.begin(), _owned.begin() + static_cast<std::ptrdiff_t>(dropped));
+                _front %= island_size;
+            }
+
+            // Publishes the edits and ends the transaction. A multi writer transaction returns false without
+            // publishing anything if another writer committed since it started.
+            bool commit() {
+                assert(is_open());
+                island** new_data = nullptr;
+                if (!_block.empty()) {
+                    new_data = pool_allocator<island*>{}.allocate(_block.size());
+                    std::ranges::copy(_block | std::ranges::views::transform([](const island* p) {
+                        return const_cast<island*>(p);
+                    }), new_data);
+                }
+                const auto* old = _base.ptr;
+                if constexpr (is_multi_writer) {
+                    if (!_deque._ref_block.compare_exchange_strong(_base, {new_data, _size, _front}, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                        pool_allocator<island*>{}.deallocate(new_data);
+                        discard();
+                        _read_guard.unlock();
+                        return false;
+                    }
+                }
+                else {
+                    _deque._ref_block.store({new_data, _size, _front}, std::memory_order_release);
+                    // the tail island may be shared with snapshots that saw past the new end
+                    _deque._capacity = _block.size();
+                    _deque._frozen = _block.size() * island_size;
+                }
+
+                if (old) {
+                    rcu_retire(const_cast<island**>(old), pool_array_deleter<island*>{}, _deque._domain);
+                }
+                for (auto&& p : _replaced) {
+                    _deque.retire_island(p, _maps);
+                }
+                if constexpr (is_multi_writer)
+                    _read_guard.unlock();
+                else
+                    _guard.unlock();
+                return true;
+            }
         };
+
         std::mutex _write_lock;
         std::atomic<ref_block_t> _ref_block;
+        Domain& _domain;
+        std::atomic<const mappings_t*> _mappings{};
+        // single writer only, requires _write_lock: the slots allocated for the pointer block, and the index
+        // counted from the start of its first island below which snapshots may have seen an element, so
+        // appends below it copy the tail island instead of writing to it in place
+        std::size_t _capacity{};
+        std::size_t _frozen{};
 
-        deque() : _write_lock{}, _ref_block{} {}
+        explicit deque(Domain& dom = rcu_default_domain()) : _write_lock{}, _ref_block{}, _domain{dom} {}
         template<class R>
-        explicit deque(R&& rg) : _write_lock{}, _ref_block{{nullptr, 0}} {
+        explicit deque(R&& rg, Domain& dom = rcu_default_domain()) : _write_lock{}, _ref_block{{nullptr, 0}}, _domain{dom} {
             const auto size = rg.size();
             if (size) {
-                const auto block_size = (size + island_size - 1) / island_size;
-                island** ptr = std::allocator<island*>{}.allocate(block_size);
+                const auto block_size = num_islands(size);
+                island** ptr = pool_allocator<island*>{}.allocate(block_size);
                 for (auto&& [i, p] : std::ranges::views::zip(rg | std::ranges::views::chunk(island_size), std::span{ptr, block_size})) {
-                    p = new island{};
+                    p = pool_new<island>();
                     std::ranges::copy(i, p->data());
                 }
                 _ref_block.store({ptr, size}, std::memory_order_release);
+                _capacity = block_size;
             }
         }
+        // maps a file written by dump(), see remap()
+        deque(map_file_t, const std::filesystem::path& path, Domain& dom = rcu_default_domain()) requires std::is_trivially_copyable_v<T> :
+            deque(dom) {
+            remap(path);
+        }
         deque(deque const&) = delete;
         deque(deque&&) = delete;
         deque& operator=(deque const&) = delete;
         deque& operator=(deque&&) = delete;
         ~deque() {
-            auto block = ref_span();
-            for (auto&& i : block) {
-                delete i;
+            const auto* maps = _mappings.load(std::memory_order_acquire);
+            for (auto&& i : ref_span()) {
+                if (!maps || !maps->contains(i))
+                    pool_delete(i);
+            }
+            pool_allocator<island*>{}.deallocate(const_cast<island**>(_ref_block.load(std::memory_order_acquire).ptr));
+            if (maps) {
+                delete maps->current;
+                delete maps;
             }
-            std::allocator<island*>{}.deallocate(const_cast<island**>(block.data()), block.size());
         }
 
         iter begin(std::span<const island* const>  span) {
@@ -164,12 +508,243 @@ namespace rcu {
         iter end(std::span<const island* const>  span) {
             return iter{span.data(), span.size()};
         }
+        // the islands holding a block's elements, the first one starting at front % island_size
+        static std::span<const island* const> live_islands(const ref_block_t& block) noexcept {
+            return {block.ptr + block.front / island_size, num_islands(block.front % island_size + block.size)};
+        }
         auto ref_span() noexcept {
-            auto block = _ref_block.load(std::memory_order_acquire);
-            return std::span<const island* const>{block.ptr, block.size == 0 ? 0 : (block.size + island_size - 1) / island_size};
+            return live_islands(_ref_block.load(std::memory_order_acquire));
         }
         auto view() noexcept {
-            return view_t{ref_span()};
+            auto block = _ref_block.load(std::memory_order_acquire);
+            const std::size_t first = block.front % island_size;
+            return view_t{std::span<const island* const>{block.ptr + block.front / island_size, num_islands(first + block.size)}, block.size, first};
+        }
+
+        transaction begin_transaction() {
+            return transaction{*this};
+        }
+        // Runs f(tx) on a transaction and commits it. On a multi writer deque, f runs again on a fresh
+        // transaction every time another writer commits first, so it must only depend on what tx shows.
+        template<class F>
+        void update(F&& f) {
+            while (true) {
+                auto tx = begin_transaction();
+                std::invoke(f, tx);
+                if (tx.commit())
+                    return;
+            }
+        }
+        // Single writer appends write to the tail island in place and publish the new size, the pointer block
+        // is only reallocated, at twice the islands in use, once its slots run out.
+        void push_back(const T& val) {
+            if constexpr (is_multi_writer) {
+                update([&](transaction& tx) {
+                    tx.push_back(val);
+                });
+                return;
+            }
+            std::scoped_lock guard{_write_lock};
+            auto block = _ref_block.load(std::memory_order_relaxed);
+            append(block, val);
+            _ref_block.store(block, std::memory_order_release);
+        }
+        template<class R>
+        void append_range(R&& rg) {
+            if constexpr (is_multi_writer) {
+                update([&](transaction& tx) {
+                    tx.append_range(rg);
+                });
+                return;
+            }
+            std::scoped_lock guard{_write_lock};
+            auto block = _ref_block.load(std::memory_order_relaxed);
+            for (auto&& i : rg) {
+                append(block, i);
+            }
+            _ref_block.store(block, std::memory_order_release);
+        }
+        // Removes the first n elements without copying the rest, for use as a sliding window with push_back().
+        // Islands that no longer hold an element are retired.
+        void drop_front(const std::size_t n) {
+            if constexpr (is_multi_writer) {
+                drop_front_shared(n);
+                return;
+            }
+            std::scoped_lock guard{_write_lock};
+            const auto block = _ref_block.load(std::memory_order_relaxed);
+            assert(n <= block.size);
+            const std::size_t front = block.front + n;
+            const std::size_t size = block.size - n;
+            if (front > max_front) {
+                relocate(block.ptr, front, size, front / island_size - block.front / island_size);
+                return;
+            }
+            _ref_block.store({block.ptr, size, front}, std::memory_order_release);
+            const auto* maps = _mappings.load(std::memory_order_relaxed);
+            for (auto i = block.front / island_size; i < front / island_size; i++) {
+                retire_island(block.ptr[i], maps);
+            }
+        }
+        void pop_front() {
+            drop_front(1);
+        }
+        void set(const std::size_t pos, const T& val) {
+            update([&](transaction& tx) {
+                tx.set(pos, val);
+            });
+        }
+        void pop_back() {
+            update([](transaction& tx) {
+                tx.pop_back();
+            });
+        }
+
+        // Replaces the elements with those of a file written by dump(). Islands point straight into a
+        // read-only mapping of the file, only a partial tail island is copied, and writers copy the islands
+        // they change. The old elements and the file they were mapped from are retired. Throws
+        // std::system_error if the file can't be mapped or wasn't written for T.
+        void remap(const std::filesystem::path& path) requires std::is_trivially_copyable_v<T> {
+            static_assert(sizeof(island) == island_size * sizeof(T) && alignof(T) <= sizeof(deque_file_header));
+            auto file = std::make_unique<const mapped_file>(path);
+            const auto bytes = file->bytes();
+            deque_file_header header;
+            if (bytes.size() >= sizeof(header))
+                std::memcpy(&header, bytes.data(), sizeof(header));
+            if (bytes.size() < sizeof(header) || header.magic != deque_file_header::file_magic || header.element_size != sizeof(T) ||
+                header.element_align != alignof(T) || (bytes.size() - sizeof(header)) / sizeof(T) < header.count)
+                throw std::system_error{std::make_error_code(std::errc::invalid_argument), "not a deque file of this element type: " + path.string()};
+
+            const std::size_t size = header.count;
+            const auto islands = num_islands(size);
+            const auto* elements = bytes.data() + sizeof(header);
+            island** data = islands != 0 ? pool_allocator<island*>{}.allocate(islands) : nullptr;
+            for (std::size_t i = 0; i < size / island_size; i++) {
+                data[i] = const_cast<island*>(reinterpret_cast<const island*>(elements + i * sizeof(island)));
+            }
+            // a partial tail island would reach past the end of the file
+            if (size % island_size != 0) {
+                data[islands - 1] = pool_new<island>();
+                std::memcpy(data[islands - 1]->data(), elements + (islands - 1) * sizeof(island), size % island_size * sizeof(T));
+            }
+
+            std::scoped_lock guard{_write_lock};
+            const auto* old_maps = _mappings.load(std::memory_order_relaxed);
+            const auto* old_file = old_maps ? old_maps->current : nullptr;
+            // writers still working on the old block have to recognize its islands until it is replaced
+            const auto* both = new mappings_t{file.get(), old_file};
+            _mappings.store(both, std::memory_order_release);
+            const auto old = _ref_block.exchange({data, size}, std::memory_order_acq_rel);
+            _capacity = islands;
+            _frozen = 0;
+            _mappings.store(new mappings_t{file.release(), nullptr}, std::memory_order_release);
+
+            for (auto&& i : live_islands(old)) {
+                retire_island(i, both);
+            }
+            if (old.ptr)
+                rcu_retire(const_cast<island**>(old.ptr), pool_array_deleter<island*>{}, _domain);
+            rcu_retire(const_cast<mappings_t*>(both), std::default_delete<mappings_t>{}, _domain);
+            if (old_maps) {
+                rcu_retire(const_cast<mappings_t*>(old_maps), std::default_delete<mappings_t>{}, _domain);
+                rcu_retire(const_cast<mapped_file*>(old_file), std::default_delete<mapped_file>{}, _domain);
+            }
+        }
+        // Writes a snapshot in the format remap() reads, from inside a read-side critical section. The file is
+        // written next to path and renamed over it, so existing mappings of path keep their version.
+        void dump(const std::filesystem::path& path) requires std::is_trivially_copyable_v<T> {
+            auto tmp = path;
+            tmp += ".tmp";
+            {
+                std::ofstream out{tmp, std::ios::binary | std::ios::trunc};
+                std::scoped_lock read_guard{_domain};
+                const auto snapshot = view();
+                const deque_file_header header{.element_size = sizeof(T), .element_align = alignof(T), .count = snapshot.size()};
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                for (auto&& segment : snapshot.segments()) {
+                    out.write(reinterpret_cast<const char*>(segment.data()), static_cast<std::streamsize>(segment.size_bytes()));
+                }
+                out.flush();
+                if (!out)
+                    throw std::system_error{std::make_error_code(std::errc::io_error), "write " + tmp.string()};
+            }
+            std::filesystem::rename(tmp, path);
+        }
+
+    private:
+        // retires an island taken out of the published block, unless it belongs to a mapped file; maps must
+        // have been loaded after the block it was taken from
+        void retire_island(const island* p, const mappings_t* maps) {
+            if (!maps || !maps->contains(p))
+                rcu_retire(const_cast<island*>(p), pool_deleter<island>{}, _domain);
+        }
+        // Moves the front with a compare_exchange, which needs no new pointer block. The critical section
+        // keeps the dropped islands from being reclaimed by another writer's commit before the exchange.
+        void drop_front_shared(const std::size_t n) {
+            std::unique_lock read_guard{_domain};
+            auto block = _ref_block.load(std::memory_order_acquire);
+            const mappings_t* maps;
+            while (true) {
+                maps = _mappings.load(std::memory_order_acquire);
+                assert(n <= block.size);
+                const std::size_t front = block.front + n;
+                if (front > max_front) {
+                    read_guard.unlock();
+                    update([n](transaction& tx) {
+                        tx.drop_front(n);
+                    });
+                    return;
+                }
+                if (_ref_block.compare_exchange_weak(block, {block.ptr, block.size - n, front}, std::memory_order_acq_rel, std::memory_order_acquire))
+                    break;
+            }
+            for (auto i = block.front / island_size; i < (block.front + n) / island_size; i++) {
+                retire_island(block.ptr[i], maps);
+            }
+        }
+        // requires _write_lock, writes val past the end of block and grows it without publishing the new size
+        void append(ref_block_t& block, const T& val) {
+            std::size_t end = block.front + block.size;
+            if (end % island_size == 0 ? end / island_size == _capacity : end < _frozen) {
+                block = relocate(block.ptr, block.front, block.size);
+                end = block.front + block.size;
+            }
+            if (end % island_size == 0)
+                const_cast<const island*&>(block.ptr[end / island_size]) = pool_new<island>();
+            (*const_cast<island*>(block.ptr[end / island_size]))[end % island_size] = val;
+            block.size++;
+        }
+        // Requires _write_lock. Publishes the elements [front, front + size) of ptr's islands in a new pointer
+        // block with room for as many islands again and retires the old one. The dropped islands just before
+        // front's are read out of ptr and retired first, since retiring ptr may reclaim it on the spot. The tail
+        // island is copied if snapshots may have seen past its end, so that every slot after the end can be
+        // written in place.
+        ref_block_t relocate(const island* const* ptr, const std::size_t front, const std::size_t size, const std::size_t dropped = 0) {
+            const std::size_t first = front % island_size;
+            const auto islands = num_islands(first + size);
+            const auto capacity = 2 * (islands + 1);
+            island** data = pool_allocator<island*>{}.allocate(capacity);
+            for (std::size_t i = 0; i < islands; i++) {
+                data[i] = const_cast<island*>(ptr[front / island_size + i]);
+            }
+            island* replaced = nullptr;
+            if ((first + size) % island_size != 0 && front + size < _frozen) {
+                replaced = data[islands - 1];
+                data[islands - 1] = pool_new<island>(*replaced);
+            }
+            const ref_block_t block{data, size, first};
+            _ref_block.store(block, std::memory_order_release);
+            _capacity = capacity;
+            _frozen = 0;
+            const auto* maps = _mappings.load(std::memory_order_relaxed);
+            for (auto i = front / island_size - dropped; i < front / island_size; i++) {
+                retire_island(ptr[i], maps);
+            }
+            if (ptr)
+                rcu_retire(const_cast<island**>(ptr), pool_array_deleter<island*>{}, _domain);
+            if (replaced)
+                retire_island(replaced, maps);
+            return block;
         }
     };
 
@@ -223,17 +798,18 @@ namespace rcu {
         };
         struct view_t : std::ranges::view_interface<view_t> {
             std::span<const island* const> data;
-            explicit view_t(std::span<const island* const>  data) : data(data) {}
+            std::size_t count;
+            explicit view_t(std::span<const island* const>  data, std::size_t count) : data(data), count(count) {}
             view_t() = default;
 
             auto begin() const noexcept {
                 return iter{data.data(), 0};
             }
             auto end() const noexcept {
-                return iter{data.data(), island_size * size()};
+                return iter{data.data(), count};
             }
             auto size() const noexcept {
-                return island_size * data.size();
+                return count;
             }
         };
 
@@ -281,7 +857,7 @@ namespace rcu {
             return std::span<const island* const>{block.ptr, block.size == 0 ? 0 : (block.size + island_size - 1) / island_size};
         }
         auto view() noexcept {
-            return view_t{ref_span()};
+            return view_t{ref_span(), _ref_block.size};
         }
     };
 }
@@ -0,0 +1,250 @@
+#ifndef RCU_MAP_H
+#define RCU_MAP_H
+#include <array>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <shared_mutex>
+
+#include "rcu.h"
+
+namespace rcu {
+    // An ordered map backed by a skip list. Readers traverse it without locks inside a read-side critical
+    // section of the map's domain; writers are serialized on _write_lock and never modify a published node
+    // other than its links, so replacing a value publishes a new node and retires the old one.
+    template<class K, class V, class Compare = std::less<K>, rcu_domain_type Domain = rcu_domain>
+    struct map {
+        using key_type = K;
+        using mapped_type = V;
+        using value_type = std::pair<const K, V>;
+        static constexpr std::size_t max_level = 16;
+
+        struct node : rcu_obj_base<node> {
+            const value_type kv;
+            const std::size_t level;
+            std::unique_ptr<std::atomic<node*>[]> next;
+
+            node(const K& key, const V& value, const std::size_t level) :
+                kv{key, value}, level{level}, next{new std::atomic<node*>[level]{}} {}
+        };
+
+        struct iter {
+            using iterator_concept = std::forward_iterator_tag;
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = map::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type*;
+            using reference = const value_type&;
+
+            const node* current;
+            std::optional<K> last;
+            [[no_unique_address]] Compare less;
+
+            const value_type& operator*() const noexcept {
+                return current->kv;
+            }
+            const value_type* operator->() const noexcept {
+                return &current->kv;
+            }
+            auto& operator++() noexcept {
+                current = current->next[0].load(std::memory_order_acquire);
+                if (current && last && !less(current->kv.first, *last))
+                    current = nullptr;
+                return *this;
+            }
+            auto operator++(int) noexcept {
+                auto tmp = *this;
+                operator++();
+                return tmp;
+            }
+            bool operator==(const iter& rhs) const noexcept {
+                return current == rhs.current;
+            }
+            bool operator==(std::default_sentinel_t) const noexcept {
+                return current == nullptr;
+            }
+        };
+        // [first, last) of a snapshot, only valid inside the read-side critical section it was created in
+        struct view_t : std::ranges::view_interface<view_t> {
+            iter first;
+            view_t() = default;
+            explicit view_t(iter first) : first(std::move(first)) {}
+
+            auto begin() const noexcept {
+                return first;
+            }
+            auto end() const noexcept {
+                return std::default_sentinel;
+            }
+        };
+
+        std::mutex _write_lock;
+        std::array<std::atomic<node*>, max_level> _head;
+        std::atomic<std::size_t> _size;
+        std::minstd_rand _gen;
+        [[no_unique_address]] Compare _less;
+        Domain& _domain;
+
+        explicit map(Domain& dom = rcu_default_domain()) : _write_lock{}, _head{}, _size{}, _gen{}, _less{}, _domain{dom} {}
+        template<std::ranges::input_range R>
+        explicit map(R&& rg, Domain& dom = rcu_default_domain()) : map(dom) {
+            for (auto&& [k, v] : rg) {
+                insert(k, v);
+            }
+        }
+        map(map const&) = delete;
+        map(map&&) = delete;
+        map& operator=(map const&) = delete;
+        map& operator=(map&&) = delete;
+        ~map() {
+            for (auto* n = _head[0].load(std::memory_order_relaxed); n;) {
+                delete std::exchange(n, n->next[0].load(std::memory_order_relaxed));
+            }
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return _size.load(std::memory_order_relaxed);
+        }
+
+        // the following are only valid inside a read-side critical section of the map's domain
+        const V* find(const K& key) const noexcept {
+            const auto* n = lower_bound_node(key);
+            return n && !_less(key, n->kv.first) ? &n->kv.second : nullptr;
+        }
+        view_t view() const noexcept {
+            return view_t{iter{_head[0].load(std::memory_order_acquire), std::nullopt, _less}};
+        }
+        view_t lower_bound(const K& first) const noexcept {
+            return view_t{iter{lower_bound_node(first), std::nullopt, _less}};
+        }
+        view_t range(const K& first, const K& last) const {
+            const auto* n = lower_bound_node(first);
+            if (n && !_less(n->kv.first, last))
+                n = nullptr;
+            return view_t{iter{n, last, _less}};
+        }
+
+        std::optional<V> get(const K& key) const {
+            std::scoped_lock guard{_domain};
+            const auto* value = find(key);
+            return value ? std::optional<V>{*value} : std::nullopt;
+        }
+        bool contains(const K& key) const {
+            std::scoped_lock guard{_domain};
+            return find(key) != nullptr;
+        }
+
+        bool insert(const K& key, const V& value) {
+            std::scoped_lock guard{_write_lock};
+            std::array<std::atomic<node*>*, max_level> preds;
+            if (const auto* n = find_preds(key, preds); n && !_less(key, n->kv.first))
+                return false;
+            link(new node{key, value, random_level()}, preds);
+            _size.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        void insert_or_assign(const K& key, const V& value) {
+            std::scoped_lock guard{_write_lock};
+            std::array<std::atomic<node*>*, max_level> preds;
+            auto* old = find_preds(key, preds);
+            if (!old || _less(key, old->kv.first)) {
+                link(new node{key, value, random_level()}, preds);
+                _size.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto* n = new node{key, value, old->level};
+            for (std::size_t i = 0; i < n->level; i++) {
+                n->next[i].store(old->next[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            for (std::size_t i = 0; i < n->level; i++) {
+                preds[i]->store(n, std::memory_order_release);
+            }
+            old->retire({}, _domain);
+        }
+        bool erase(const K& key) {
+            std::scoped_lock guard{_write_lock};
+            std::array<std::atomic<node*>*, max_level> preds;
+            auto* old = find_preds(key, preds);
+            if (!old || _less(key, old->kv.first))
+                return false;
+            for (std::size_t i = old->level; i-- > 0;) {
+                preds[i]->store(old->next[i].load(std::memory_order_relaxed), std::memory_order_release);
+            }
+            old->retire({}, _domain);
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        // returns the node the level 0 scan stopped at, reloading the link could see a node inserted since
+        const node* lower_bound_node(const K& key) const noexcept {
+            const std::atomic<node*>* links = _head.data();
+            const node* n = nullptr;
+            for (std::size_t i = max_level; i-- > 0;) {
+                for (n = links[i].load(std::memory_order_acquire); n && _less(n->kv.first, key); n = links[i].load(std::memory_order_acquire)) {
+                    links = n->next.get();
+                }
+            }
+            return n;
+        }
+        // requires _write_lock, returns the first node not less than key
+        node* find_preds(const K& key, std::array<std::atomic<node*>*, max_level>& preds) {
+            std::atomic<node*>* links = _head.data();
+            for (std::size_t i = max_level; i-- > 0;) {
+                for (auto* n = links[i].load(std::memory_order_relaxed); n && _less(n->kv.first, key); n = links[i].load(std::memory_order_relaxed)) {
+                    links = n->next.get();
+                }
+                preds[i] = &links[i];
+            }
+            return preds[0]->load(std::memory_order_relaxed);
+        }
+        // links bottom-up so that a node is reachable at level 0 before any express lane leads to it
+        static void link(node* n, const std::array<std::atomic<node*>*, max_level>& preds) noexcept {
+            for (std::size_t i = 0; i < n->level; i++) {
+                n->next[i].store(preds[i]->load(std::memory_order_relaxed), std::memory_order_relaxed);
+                preds[i]->store(n, std::memory_order_release);
+            }
+        }
+        std::size_t random_level() noexcept {
+            // each level is promoted with probability 1/4
+            const auto bits = static_cast<std::uint32_t>(_gen()) | (1u << (2 * (max_level - 1)));
+            return 1 + std::countr_zero(bits) / 2;
+        }
+    };
+
+    template<class K, class V, class Compare = std::less<K>>
+    struct shared_mutex_map {
+        using key_type = K;
+        using mapped_type = V;
+
+        std::shared_mutex _lock;
+        std::map<K, V, Compare> _map;
+
+        shared_mutex_map() : _lock{}, _map{} {}
+        template<std::ranges::input_range R>
+        explicit shared_mutex_map(R&& rg) : _lock{}, _map{} {
+            for (auto&& [k, v] : rg) {
+                _map.emplace(k, v);
+            }
+        }
+        shared_mutex_map(shared_mutex_map const&) = delete;
+        shared_mutex_map(shared_mutex_map&&) = delete;
+        shared_mutex_map& operator=(shared_mutex_map const&) = delete;
+        shared_mutex_map& operator=(shared_mutex_map&&) = delete;
+
+        void insert_or_assign(const K& key, const V& value) {
+            std::unique_lock guard{_lock};
+            _map.insert_or_assign(key, value);
+        }
+    };
+}
+
+
+#endif //RCU_MAP_H
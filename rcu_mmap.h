@@ -0,0 +1,53 @@
+#ifndef RCU_MMAP_H
+#define RCU_MMAP_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace rcu {
+    // Layout of a file written by deque::dump(): this header, then count elements of element_size bytes
+    // each, stored as they are in memory. Elements start at an offset of 64 bytes, so a page aligned mapping
+    // keeps them aligned.
+    struct deque_file_header {
+        static constexpr std::array<char, 8> file_magic{'r', 'c', 'u', 'd', 'e', 'q', '0', '1'};
+
+        std::array<char, 8> magic = file_magic;
+        std::uint64_t element_size{};
+        std::uint64_t element_align{};
+        std::uint64_t count{};
+        std::array<std::byte, 32> reserved{};
+    };
+    static_assert(sizeof(deque_file_header) == 64);
+
+    // A whole file mapped read-only, unmapped when destroyed. Throws std::system_error if the file can't be
+    // opened or mapped.
+    class mapped_file {
+        void* addr{};
+        std::size_t length{};
+
+    public:
+        explicit mapped_file(const std::filesystem::path& path);
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        ~mapped_file();
+
+        [[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+            return {static_cast<const std::byte*>(addr), length};
+        }
+        [[nodiscard]] bool contains(const void* p) const noexcept {
+            const auto b = bytes();
+            return p >= b.data() && p < b.data() + b.size();
+        }
+    };
+
+    struct map_file_t {
+        explicit map_file_t() = default;
+    };
+    // selects the deque constructor that maps a file written by deque::dump()
+    inline constexpr map_file_t map_file{};
+}
+
+
+#endif //RCU_MMAP_H
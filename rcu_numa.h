@@ -0,0 +1,47 @@
+#ifndef RCU_NUMA_H
+#define RCU_NUMA_H
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace rcu {
+    // Which NUMA node each CPU belongs to, nodes numbered densely from 0. A domain built on a topology keeps
+    // reader slots and garbage per node, see basic_rcu_domain.
+    class numa_topology {
+        std::vector<std::size_t> cpu_nodes;
+        std::size_t nodes = 1;
+
+    public:
+        // a single node holding every CPU
+        numa_topology() = default;
+        // cpu_nodes[cpu] is the cpu's node
+        explicit numa_topology(std::vector<std::size_t> cpu_nodes);
+
+        // The machine's topology as listed under /sys/devices/system/node, a single node if there is none.
+        static numa_topology detect();
+        // Either a node count, which splits the CPUs into that many contiguous nodes, or one CPU list per
+        // node separated by ';', e.g. "0-3,8-11;4-7,12-15". Malformed specs give a single node.
+        static numa_topology parse(std::string_view spec);
+        // parse(RCU_NUMA_NODES) if that environment variable is set, detect() otherwise
+        static const numa_topology& system();
+
+        [[nodiscard]] std::size_t num_nodes() const noexcept {
+            return nodes;
+        }
+        // CPUs outside the topology are taken to be on node 0
+        [[nodiscard]] std::size_t node_of_cpu(const std::size_t cpu) const noexcept {
+            return cpu < cpu_nodes.size() ? cpu_nodes[cpu] : 0;
+        }
+        // the node set by set_numa_node() if any, otherwise the node of the CPU the thread runs on
+        [[nodiscard]] std::size_t current_node() const noexcept;
+    };
+
+    // Places the calling thread on node for every domain it starts reading from afterwards, regardless of
+    // the CPU it runs on, e.g. to simulate a topology on a single node machine. Domains with fewer nodes
+    // wrap it around.
+    void set_numa_node(std::size_t node) noexcept;
+    void clear_numa_node() noexcept;
+}
+
+
+#endif //RCU_NUMA_H
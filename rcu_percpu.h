@@ -0,0 +1,65 @@
+#ifndef RCU_PERCPU_H
+#define RCU_PERCPU_H
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace rcu {
+    // SRCU style reader accounting: each critical section adds 1 to its CPU's lock count for the current
+    // phase on entry and to the unlock count of the same phase on exit, so readers never write to a shared
+    // line and the cost of a grace period scales with the number of CPUs, not threads. On x86-64 Linux the
+    // counts are bumped by restartable sequences and ordered by membarrier() on the writer side, leaving
+    // readers without atomic RMWs or fences; anywhere else, or if the kernel offers neither, readers fall
+    // back to atomic increments and fences.
+    class percpu_readers {
+        struct alignas(64) cpu_counts {
+            // lock counts of phase 0 and 1, then their unlock counts
+            std::array<std::atomic<std::uint64_t>, 4> counts{};
+        };
+
+        // indexed by CPU id, up to the highest one the system may bring online
+        std::unique_ptr<cpu_counts[]> cpus;
+        // readers that can't use rseq count themselves here while others do in cpus, as a plain add on a
+        // CPU's counter only excludes other rseq threads; null if no reader uses rseq
+        std::unique_ptr<cpu_counts[]> fallback_cpus;
+        std::uint32_t num_cpus;
+        // Requires wait_lock. A grace period drains the other phase, flips, then drains the phase it flipped
+        // from; it is left half done when a wait times out, so that polling callers still make progress.
+        std::timed_mutex wait_lock;
+        bool flipped{};
+        // the ticket of the grace period in progress, and 1 + that of the last one to end, 0 if none has
+        std::size_t started{};
+        std::size_t ended{};
+        // flipped by every grace period, read by readers on entry
+        alignas(64) std::atomic<std::size_t> phase{};
+
+        [[nodiscard]] std::uint64_t sum(std::size_t counter) const noexcept;
+        [[nodiscard]] bool active(std::size_t phase) const noexcept;
+        bool drain(std::size_t phase, std::chrono::steady_clock::time_point deadline) const noexcept;
+        void increment(std::size_t counter, std::memory_order order) noexcept;
+
+    public:
+        percpu_readers();
+
+        // enters a critical section, returns the phase to leave it with
+        [[nodiscard]] std::size_t lock() noexcept;
+        void unlock(std::size_t phase) noexcept;
+        // Tickets order grace periods: ticket is any number the caller has seen grow, such as a generation,
+        // and a grace period started with it waits for every reader that entered before it was issued.
+        // Waits until a grace period started with a ticket of at least wanted has ended, returns false if it
+        // hasn't by deadline. Concurrent callers take turns.
+        bool wait(std::size_t wanted, std::size_t ticket, std::chrono::steady_clock::time_point deadline) noexcept;
+        // critical sections currently entered, approximate while readers come and go
+        [[nodiscard]] std::size_t readers() const noexcept;
+
+        // whether readers run on restartable sequences rather than atomics
+        [[nodiscard]] static bool uses_rseq() noexcept;
+    };
+}
+
+
+#endif //RCU_PERCPU_H
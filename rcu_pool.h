@@ -0,0 +1,253 @@
+#ifndef RCU_POOL_H
+#define RCU_POOL_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <utility>
+
+// Recycling allocators for memory that is freed after a grace period. Blocks go back to a cache owned by
+// the thread that frees them, which is usually a reclaimer or whichever writer flushed the garbage, and
+// overflow in halves to a shared list that allocating threads refill from, so memory retired on one
+// thread is reused by writers on another without going through the global heap.
+namespace rcu {
+    template<std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+    class fixed_pool {
+        static_assert(Size >= sizeof(void*) && std::has_single_bit(Align));
+
+        struct free_block {
+            free_block* next;
+        };
+        struct free_list {
+            free_block* head{};
+            std::size_t size{};
+
+            void push(void* p) noexcept {
+                head = ::new (p) free_block{head};
+                size++;
+            }
+            void* pop() noexcept {
+                size--;
+                return std::exchange(head, head->next);
+            }
+            free_list take(const std::size_t n) noexcept {
+                free_list taken;
+                while (taken.size < n && head) {
+                    taken.push(pop());
+                }
+                return taken;
+            }
+            void splice(free_list&& rhs) noexcept {
+                while (rhs.head) {
+                    push(rhs.pop());
+                }
+            }
+        };
+        struct central_t {
+            std::mutex lock;
+            free_list blocks;
+        };
+        struct cache_t {
+            free_list blocks;
+            ~cache_t() {
+                exited = true;
+                give_back(std::move(blocks));
+            }
+        };
+
+        // never destroyed, so that threads exiting after static destruction can still return their blocks
+        static central_t& central() {
+            static auto* c = new central_t{};
+            return *c;
+        }
+        inline static thread_local cache_t cache;
+        inline static thread_local bool exited = false;
+
+        static void* heap_allocate() {
+            if constexpr (Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                return ::operator new(Size, std::align_val_t{Align});
+            else
+                return ::operator new(Size);
+        }
+        static void heap_deallocate(void* p) noexcept {
+            if constexpr (Align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                ::operator delete(p, Size, std::align_val_t{Align});
+            else
+                ::operator delete(p, Size);
+        }
+        // moves blocks to the shared list and frees whatever does not fit there
+        static void give_back(free_list&& blocks) noexcept {
+            {
+                auto& c = central();
+                std::scoped_lock guard{c.lock};
+                c.blocks.splice(blocks.take(central_capacity - std::min(c.blocks.size, central_capacity)));
+            }
+            while (blocks.head) {
+                heap_deallocate(blocks.pop());
+            }
+        }
+
+    public:
+        static constexpr std::size_t block_size = Size;
+        // 256 KiB per thread and 16 MiB shared, rounded down to whole blocks but never below one
+        static constexpr std::size_t cache_capacity = std::max<std::size_t>(1, (256 << 10) / Size);
+        static constexpr std::size_t central_capacity = std::max<std::size_t>(1, (16 << 20) / Size);
+        // blocks moved between a thread's cache and the shared list at a time, half the cache
+        static constexpr std::size_t transfer_size = std::max<std::size_t>(1, cache_capacity / 2);
+
+        [[nodiscard]] static void* allocate() {
+            if (exited) [[unlikely]]
+                return heap_allocate();
+            auto& local = cache;
+            if (!local.blocks.head) {
+                auto& c = central();
+                std::scoped_lock guard{c.lock};
+                local.blocks.splice(c.blocks.take(transfer_size));
+            }
+            return local.blocks.head ? local.blocks.pop() : heap_allocate();
+        }
+        static void deallocate(void* p) noexcept {
+            if (exited) [[unlikely]] {
+                free_list single;
+                single.push(p);
+                give_back(std::move(single));
+                return;
+            }
+            auto& local = cache;
+            local.blocks.push(p);
+            if (local.blocks.size > cache_capacity) [[unlikely]]
+                give_back(local.blocks.take(transfer_size));
+        }
+        // as deallocate() for every non-null block, checking the cache's capacity once
+        template<class T>
+        static void deallocate(const std::span<T* const> ps) noexcept {
+            if (exited) [[unlikely]] {
+                for (auto* p : ps) {
+                    if (p)
+                        deallocate(p);
+                }
+                return;
+            }
+            auto& local = cache;
+            for (auto* p : ps) {
+                if (p)
+                    local.blocks.push(p);
+            }
+            if (local.blocks.size > cache_capacity) [[unlikely]]
+                give_back(local.blocks.take(local.blocks.size - transfer_size));
+        }
+    };
+
+    template<class T, class... Args>
+    [[nodiscard]] T* pool_new(Args&&... args) {
+        using pool = fixed_pool<sizeof(T), std::max(alignof(T), alignof(std::max_align_t))>;
+        void* p = pool::allocate();
+        try {
+            return ::new (p) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            pool::deallocate(p);
+            throw;
+        }
+    }
+    template<class T>
+    void pool_delete(const T* p) noexcept {
+        using pool = fixed_pool<sizeof(T), std::max(alignof(T), alignof(std::max_align_t))>;
+        if (p) {
+            p->~T();
+            pool::deallocate(const_cast<T*>(p));
+        }
+    }
+    // stateless, so retiring with it never allocates a deleter
+    template<class T>
+    struct pool_deleter {
+        void operator()(T* p) const noexcept {
+            pool_delete(p);
+        }
+        // a whole typed retire batch at once
+        void operator()(const std::span<T* const> ps) const noexcept {
+            using pool = fixed_pool<sizeof(T), std::max(alignof(T), alignof(std::max_align_t))>;
+            for (auto* p : ps) {
+                if (p)
+                    p->~T();
+            }
+            pool::deallocate(ps);
+        }
+    };
+
+    // Variable-length arrays, pooled in power of two size classes. A small header in front of every array
+    // records its class, so an array is freed without knowing its length.
+    class array_pool {
+        static constexpr std::size_t header_size = alignof(std::max_align_t);
+        static constexpr std::size_t min_class = 6;
+        static constexpr std::size_t max_class = 20;
+        static constexpr std::size_t num_classes = max_class - min_class + 1;
+        static constexpr std::size_t unpooled = num_classes;
+
+        struct size_class_t {
+            void* (*allocate)();
+            void (*deallocate)(void*) noexcept;
+        };
+        template<std::size_t... I>
+        static constexpr auto make_classes(std::index_sequence<I...>) noexcept {
+            return std::array<size_class_t, num_classes>{size_class_t{
+                &fixed_pool<std::size_t{1} << (min_class + I)>::allocate,
+                &fixed_pool<std::size_t{1} << (min_class + I)>::deallocate
+            }...};
+        }
+        static const size_class_t& get_class(const std::size_t size_class) noexcept {
+            static constexpr auto classes = make_classes(std::make_index_sequence<num_classes>{});
+            return classes[size_class];
+        }
+
+    public:
+        [[nodiscard]] static void* allocate(const std::size_t bytes) {
+            const auto total = bytes + header_size;
+            const auto size_class = std::max<std::size_t>(std::bit_width(total - 1), min_class) - min_class;
+            auto* block = static_cast<std::byte*>(size_class < num_classes ? get_class(size_class).allocate() : ::operator new(total));
+            *reinterpret_cast<std::size_t*>(block) = std::min(size_class, unpooled);
+            return block + header_size;
+        }
+        static void deallocate(void* p) noexcept {
+            if (!p)
+                return;
+            auto* block = static_cast<std::byte*>(p) - header_size;
+            if (const auto size_class = *reinterpret_cast<std::size_t*>(block); size_class < num_classes)
+                get_class(size_class).deallocate(block);
+            else
+                ::operator delete(block);
+        }
+    };
+
+    // std::allocator replacement for arrays freed after a grace period, deallocation ignores the length
+    template<class T>
+    struct pool_allocator {
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+        using value_type = T;
+
+        pool_allocator() = default;
+        template<class U>
+        explicit pool_allocator(const pool_allocator<U>&) noexcept {}
+
+        [[nodiscard]] T* allocate(const std::size_t n) {
+            return static_cast<T*>(array_pool::allocate(n * sizeof(T)));
+        }
+        void deallocate(T* p, std::size_t = 0) noexcept {
+            array_pool::deallocate(p);
+        }
+        bool operator==(const pool_allocator&) const noexcept = default;
+    };
+    template<class T>
+    struct pool_array_deleter {
+        void operator()(T* p) const noexcept {
+            pool_allocator<T>{}.deallocate(p);
+        }
+    };
+}
+
+
+#endif //RCU_POOL_H
@@ -0,0 +1,388 @@
+#ifndef RCU_SCAN_H
+#define RCU_SCAN_H
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <experimental/simd>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Island-aware scans over rcu::deque snapshots. Every island is a contiguous array, so each one is handed
+// to a kernel that runs on the widest native vector type -march provides (AVX-512, AVX2, SSE...) and falls
+// back to a scalar loop for the tail and for types that cannot be vectorized.
+namespace rcu::scan {
+    namespace stdx = std::experimental;
+
+    template<class T>
+    concept vectorizable = std::is_arithmetic_v<T> && !std::is_same_v<T, bool>;
+
+    template<class T>
+    using simd_t = stdx::native_simd<T>;
+
+    // kernels over a single contiguous block
+    template<class T>
+    std::size_t find(std::span<const T> data, const T& value) noexcept {
+        std::size_t i = 0;
+        if constexpr (vectorizable<T>) {
+            for (; i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                const auto mask = simd_t<T>{&data[i], stdx::element_aligned} == value;
+                if (stdx::any_of(mask))
+                    return i + stdx::find_first_set(mask);
+            }
+        }
+        for (; i < data.size(); i++) {
+            if (data[i] == value)
+                return i;
+        }
+        return data.size();
+    }
+    template<class T, class Pred>
+    std::size_t find_if(std::span<const T> data, Pred&& pred) {
+        std::size_t i = 0;
+        if constexpr (vectorizable<T> && std::is_invocable_r_v<typename simd_t<T>::mask_type, Pred&, simd_t<T>>) {
+            for (; i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                const auto mask = std::invoke(pred, simd_t<T>{&data[i], stdx::element_aligned});
+                if (stdx::any_of(mask))
+                    return i + stdx::find_first_set(mask);
+            }
+        }
+        for (; i < data.size(); i++) {
+            if (std::invoke(pred, data[i]))
+                return i;
+        }
+        return data.size();
+    }
+    template<class T>
+    std::size_t count(std::span<const T> data, const T& value) noexcept {
+        std::size_t i = 0, n = 0;
+        if constexpr (vectorizable<T>) {
+            for (; i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                n += stdx::popcount(simd_t<T>{&data[i], stdx::element_aligned} == value);
+            }
+        }
+        for (; i < data.size(); i++) {
+            n += data[i] == value;
+        }
+        return n;
+    }
+    template<class T, class Pred>
+    std::size_t count_if(std::span<const T> data, Pred&& pred) {
+        std::size_t i = 0, n = 0;
+        if constexpr (vectorizable<T> && std::is_invocable_r_v<typename simd_t<T>::mask_type, Pred&, simd_t<T>>) {
+            for (; i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                n += stdx::popcount(std::invoke(pred, simd_t<T>{&data[i], stdx::element_aligned}));
+            }
+        }
+        for (; i < data.size(); i++) {
+            n += static_cast<bool>(std::invoke(pred, data[i]));
+        }
+        return n;
+    }
+    // folds data into init with op, which must be associative and commutative and accept both T and simd_t<T>
+    template<class T, class Op>
+    T reduce(std::span<const T> data, T init, Op&& op) {
+        std::size_t i = 0;
+        if constexpr (vectorizable<T>) {
+            if (data.size() >= simd_t<T>::size()) {
+                simd_t<T> acc{&data[0], stdx::element_aligned};
+                for (i = simd_t<T>::size(); i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                    acc = std::invoke(op, acc, simd_t<T>{&data[i], stdx::element_aligned});
+                }
+                init = std::invoke(op, init, stdx::reduce(acc, op));
+            }
+        }
+        for (; i < data.size(); i++) {
+            init = std::invoke(op, init, data[i]);
+        }
+        return init;
+    }
+    // like reduce over transform(data); vectorized when transform maps simd_t<T> to simd_t<U>
+    template<class T, class U, class Op, class Transform>
+    U transform_reduce(std::span<const T> data, U init, Op&& op, Transform&& transform) {
+        std::size_t i = 0;
+        if constexpr (vectorizable<T> && std::is_same_v<T, U> && std::is_invocable_r_v<simd_t<T>, Transform&, simd_t<T>>) {
+            if (data.size() >= simd_t<T>::size()) {
+                simd_t<T> acc = std::invoke(transform, simd_t<T>{&data[0], stdx::element_aligned});
+                for (i = simd_t<T>::size(); i + simd_t<T>::size() <= data.size(); i += simd_t<T>::size()) {
+                    acc = std::invoke(op, acc, std::invoke(transform, simd_t<T>{&data[i], stdx::element_aligned}));
+                }
+                init = std::invoke(op, init, stdx::reduce(acc, op));
+            }
+        }
+        for (; i < data.size(); i++) {
+            init = std::invoke(op, init, std::invoke(transform, data[i]));
+        }
+        return init;
+    }
+
+    struct min_op {
+        template<class T>
+        T operator()(const T& a, const T& b) const {
+            if constexpr (requires { stdx::min(a, b); })
+                return stdx::min(a, b);
+            else
+                return std::min(a, b);
+        }
+    };
+    struct max_op {
+        template<class T>
+        T operator()(const T& a, const T& b) const {
+            if constexpr (requires { stdx::max(a, b); })
+                return stdx::max(a, b);
+            else
+                return std::max(a, b);
+        }
+    };
+
+    // calls f(island, offset) for every island of the view, trimming the tail island to the view's size,
+    // until f returns true
+    template<class View, class F>
+    bool for_each_island(const View& view, F&& f) {
+        std::size_t offset = 0;
+        for (auto&& island : view.segments()) {
+            if (std::invoke(f, island, offset))
+                return true;
+            offset += island.size();
+        }
+        return false;
+    }
+
+    template<class View, class T>
+    auto find(const View& view, const T& value) {
+        auto it = view.begin();
+        if (!for_each_island(view, [&](auto island, const std::size_t offset) {
+            const auto i = find(island, static_cast<typename decltype(island)::value_type>(value));
+            it = view.begin() + static_cast<std::ptrdiff_t>(offset + i);
+            return i != island.size();
+        }))
+            return view.end();
+        return it;
+    }
+    template<class View, class Pred>
+    auto find_if(const View& view, Pred pred) {
+        auto it = view.begin();
+        if (!for_each_island(view, [&](auto island, const std::size_t offset) {
+            const auto i = find_if(island, pred);
+            it = view.begin() + static_cast<std::ptrdiff_t>(offset + i);
+            return i != island.size();
+        }))
+            return view.end();
+        return it;
+    }
+    template<class View, class T>
+    std::size_t count(const View& view, const T& value) {
+        std::size_t n = 0;
+        for_each_island(view, [&](auto island, std::size_t) {
+            n += count(island, static_cast<typename decltype(island)::value_type>(value));
+            return false;
+        });
+        return n;
+    }
+    template<class View, class Pred>
+    std::size_t count_if(const View& view, Pred pred) {
+        std::size_t n = 0;
+        for_each_island(view, [&](auto island, std::size_t) {
+            n += count_if(island, pred);
+            return false;
+        });
+        return n;
+    }
+    template<class View, class T, class Op>
+    T reduce(const View& view, T init, Op op) {
+        for_each_island(view, [&](auto island, std::size_t) {
+            init = reduce(island, init, op);
+            return false;
+        });
+        return init;
+    }
+    template<class View, class U, class Op, class Transform>
+    U transform_reduce(const View& view, U init, Op op, Transform transform) {
+        for_each_island(view, [&](auto island, std::size_t) {
+            init = transform_reduce(island, init, op, transform);
+            return false;
+        });
+        return init;
+    }
+    template<class View>
+    auto sum(const View& view) {
+        using T = std::remove_cvref_t<decltype(*view.begin())>;
+        return reduce(view, T{}, std::plus<>{});
+    }
+    template<class View>
+    auto min(const View& view) {
+        using T = std::remove_cvref_t<decltype(*view.begin())>;
+        return view.size() ? std::optional<T>{reduce(view, *view.begin(), min_op{})} : std::nullopt;
+    }
+    template<class View>
+    auto max(const View& view) {
+        using T = std::remove_cvref_t<decltype(*view.begin())>;
+        return view.size() ? std::optional<T>{reduce(view, *view.begin(), max_op{})} : std::nullopt;
+    }
+
+    // Fork-join workers for scans over large snapshots. The caller joins in on its own job and only returns
+    // once every worker has left it, so workers can read a snapshot under the caller's read-side critical
+    // section without entering one of their own.
+    class worker_pool {
+        struct job {
+            void (*run)(void* f, std::size_t task);
+            void* f;
+            std::size_t num_tasks;
+            std::atomic<std::size_t> next;
+            std::size_t active;
+
+            void work() noexcept {
+                for (auto task = next.fetch_add(1, std::memory_order_relaxed); task < num_tasks; task = next.fetch_add(1, std::memory_order_relaxed)) {
+                    run(f, task);
+                }
+            }
+        };
+
+        std::mutex _lock;
+        std::condition_variable_any _wakeup;
+        std::condition_variable_any _done;
+        std::vector<job*> _jobs;
+        std::vector<std::jthread> _workers;
+
+        void worker_loop(const std::stop_token& stop) {
+            std::unique_lock guard{_lock};
+            while (_wakeup.wait(guard, stop, [this] { return !_jobs.empty(); })) {
+                auto* j = _jobs.back();
+                j->active++;
+                guard.unlock();
+                j->work();
+                guard.lock();
+                std::erase(_jobs, j);
+                if (--j->active == 0)
+                    _done.notify_all();
+            }
+        }
+
+    public:
+        explicit worker_pool(const std::size_t num_workers) {
+            _workers.reserve(num_workers);
+            for (std::size_t i = 0; i < num_workers; i++) {
+                _workers.emplace_back([this](const std::stop_token& stop) { worker_loop(stop); });
+            }
+        }
+        worker_pool(const worker_pool&) = delete;
+        worker_pool& operator=(const worker_pool&) = delete;
+        ~worker_pool() {
+            for (auto&& w : _workers) {
+                w.request_stop();
+            }
+            _workers.clear();
+        }
+
+        // threads that run a job, including the caller
+        [[nodiscard]] std::size_t concurrency() const noexcept {
+            return _workers.size() + 1;
+        }
+
+        // calls f(task) for every task in [0, num_tasks) across the pool and the calling thread, f must not throw
+        template<class F>
+        void run(const std::size_t num_tasks, F&& f) {
+            if (num_tasks <= 1 || _workers.empty()) {
+                for (std::size_t task = 0; task < num_tasks; task++) {
+                    std::invoke(f, task);
+                }
+                return;
+            }
+            job j{[](void* f, const std::size_t task) { std::invoke(*static_cast<std::remove_reference_t<F>*>(f), task); },
+                  const_cast<void*>(static_cast<const void*>(std::addressof(f))), num_tasks, 0, 0};
+            {
+                std::scoped_lock guard{_lock};
+                _jobs.push_back(&j);
+            }
+            _wakeup.notify_all();
+            j.work();
+            std::unique_lock guard{_lock};
+            std::erase(_jobs, &j);
+            _done.wait(guard, [&j] { return j.active == 0; });
+        }
+    };
+
+    inline worker_pool& default_pool() {
+        static worker_pool pool{std::max(std::thread::hardware_concurrency(), 1u) - 1};
+        return pool;
+    }
+
+    // Parallel scans split a snapshot's islands into contiguous ranges of at least min_islands_per_task
+    // islands and hand those to the pool. Call them inside a read-side critical section, like view().
+    inline constexpr std::size_t min_islands_per_task = 64;
+
+    template<class View>
+    std::size_t num_tasks(const View& view, const worker_pool& pool) noexcept {
+        const auto islands = view.segments().size();
+        return std::clamp<std::size_t>(islands / min_islands_per_task, 1, 4 * pool.concurrency());
+    }
+    // calls f(task, islands, offset) with the islands of each task and the index of their first element
+    template<class View, class F>
+    void parallel_for_each_task(const View& view, const std::size_t tasks, worker_pool& pool, F&& f) {
+        const auto segments = view.segments();
+        const auto islands = segments.size();
+        pool.run(tasks, [&](const std::size_t task) {
+            const auto first = islands * task / tasks;
+            const auto last = islands * (task + 1) / tasks;
+            std::invoke(f, task, std::ranges::subrange(segments.begin() + first, segments.begin() + last), view.segment_start(first));
+        });
+    }
+
+    template<class View, class T>
+    auto parallel_find(const View& view, const T& value, worker_pool& pool = default_pool()) {
+        using E = std::remove_cvref_t<decltype(*view.begin())>;
+        return parallel_find_if(view, [value = static_cast<E>(value)](const auto& x) { return x == value; }, pool);
+    }
+    template<class View, class Pred>
+    auto parallel_find_if(const View& view, Pred pred, worker_pool& pool = default_pool()) {
+        std::atomic<std::size_t> found = view.size();
+        parallel_for_each_task(view, num_tasks(view, pool), pool, [&](std::size_t, auto islands, std::size_t offset) {
+            for (auto&& island : islands) {
+                // a match in an earlier island already wins
+                if (offset >= found.load(std::memory_order_relaxed))
+                    return;
+                if (const auto i = find_if(island, pred); i != island.size()) {
+                    auto best = found.load(std::memory_order_relaxed);
+                    while (offset + i < best && !found.compare_exchange_weak(best, offset + i, std::memory_order_relaxed)) {}
+                    return;
+                }
+                offset += island.size();
+            }
+        });
+        return view.begin() + static_cast<std::ptrdiff_t>(found.load(std::memory_order_relaxed));
+    }
+    template<class View, class U, class Op, class Transform>
+    U parallel_transform_reduce(const View& view, U init, Op op, Transform transform, worker_pool& pool = default_pool()) {
+        const auto tasks = num_tasks(view, pool);
+        std::vector<std::optional<U>> partials(tasks);
+        parallel_for_each_task(view, tasks, pool, [&](const std::size_t task, auto islands, std::size_t) {
+            for (auto&& island : islands) {
+                if (island.empty())
+                    continue;
+                auto& partial = partials[task];
+                partial = partial ? transform_reduce(island, *partial, op, transform)
+                                  : transform_reduce(island.subspan(1), U(std::invoke(transform, island[0])), op, transform);
+            }
+        });
+        for (auto&& partial : partials) {
+            if (partial)
+                init = std::invoke(op, init, *partial);
+        }
+        return init;
+    }
+    template<class View, class T, class Op>
+    T parallel_reduce(const View& view, T init, Op op, worker_pool& pool = default_pool()) {
+        return parallel_transform_reduce(view, init, op, std::identity{}, pool);
+    }
+}
+
+
+#endif //RCU_SCAN_H
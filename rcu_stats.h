@@ -0,0 +1,167 @@
+#ifndef RCU_STATS_H
+#define RCU_STATS_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Per-domain counters and latency histograms, see basic_rcu_domain::stats(). Build with RCU_STATS=1 to
+// enable them; otherwise every hook is an empty inline function and the counters take no space.
+#ifndef RCU_STATS
+#define RCU_STATS 0
+#endif
+
+namespace rcu {
+    inline constexpr bool stats_enabled = RCU_STATS;
+
+    // durations in power of two buckets: bucket i counts durations in [2^(i-1), 2^i) nanoseconds
+    struct histogram_snapshot {
+        static constexpr std::size_t num_buckets = 48;
+        std::array<std::uint64_t, num_buckets> buckets{};
+
+        [[nodiscard]] std::uint64_t count() const noexcept {
+            std::uint64_t n = 0;
+            for (auto&& b : buckets) {
+                n += b;
+            }
+            return n;
+        }
+        // upper bound of the bucket holding the q-quantile, zero if empty
+        [[nodiscard]] std::chrono::nanoseconds quantile(const double q) const noexcept {
+            const auto target = static_cast<std::uint64_t>(q * static_cast<double>(count()));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < num_buckets; i++) {
+                seen += buckets[i];
+                if (buckets[i] && seen > target)
+                    return std::chrono::nanoseconds{std::int64_t{1} << i};
+            }
+            return std::chrono::nanoseconds{0};
+        }
+    };
+
+    class histogram {
+        std::array<std::atomic<std::uint64_t>, histogram_snapshot::num_buckets> buckets{};
+
+    public:
+        void record(const std::chrono::nanoseconds d) noexcept {
+            const auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(d.count(), 0));
+            const auto i = std::min<std::size_t>(std::bit_width(ns), histogram_snapshot::num_buckets - 1);
+            buckets[i].fetch_add(1, std::memory_order_relaxed);
+        }
+        [[nodiscard]] histogram_snapshot snapshot() const noexcept {
+            histogram_snapshot s;
+            for (std::size_t i = 0; i < s.num_buckets; i++) {
+                s.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+    };
+
+    struct rcu_stats {
+        static constexpr bool enabled = stats_enabled;
+
+        std::size_t generation{};
+        // oldest generation a reader is in, or generation if there are no readers
+        std::size_t oldest_reader_generation{};
+        std::size_t readers{};
+        std::size_t nodes{};
+
+        // garbage handed to generations and not yet reclaimed, bytes only count what was retired with a size
+        std::uint64_t pending{};
+        std::uint64_t pending_bytes{};
+        // pending garbage by age, [0] is the current generation
+        std::array<std::uint64_t, 8> pending_per_generation{};
+
+        std::uint64_t retired{};
+        std::uint64_t retired_bytes{};
+        std::uint64_t reclaimed{};
+        std::uint64_t batch_allocations{};
+        std::uint64_t generation_advances{};
+        std::uint64_t grace_periods{};
+        // waits on a single reader that took longer than the domain's stall threshold
+        std::uint64_t reader_stalls{};
+        std::size_t last_stalled_generation{};
+
+        histogram_snapshot grace_period;
+        histogram_snapshot reclaim;
+    };
+
+    template<bool Enabled = stats_enabled>
+    class domain_stats;
+
+    template<>
+    class domain_stats<false> {
+    public:
+        struct time_point {};
+        static time_point now() noexcept {
+            return {};
+        }
+        void on_batch_allocated() noexcept {}
+        void on_retired(std::size_t, std::size_t) noexcept {}
+        void on_advance() noexcept {}
+        void on_grace_period(time_point) noexcept {}
+        void on_reclaim(std::size_t, time_point) noexcept {}
+        void on_stall(std::size_t) noexcept {}
+        void fill(rcu_stats&) const noexcept {}
+    };
+
+    template<>
+    class domain_stats<true> {
+        std::atomic<std::uint64_t> retired{};
+        std::atomic<std::uint64_t> retired_bytes{};
+        std::atomic<std::uint64_t> generation_advances{};
+        std::atomic<std::uint64_t> reclaimed{};
+        std::atomic<std::uint64_t> batch_allocations{};
+        std::atomic<std::uint64_t> grace_periods{};
+        std::atomic<std::uint64_t> reader_stalls{};
+        std::atomic<std::size_t> last_stalled_generation{};
+        histogram grace_period;
+        histogram reclaim;
+
+    public:
+        using time_point = std::chrono::steady_clock::time_point;
+        static time_point now() noexcept {
+            return std::chrono::steady_clock::now();
+        }
+        void on_batch_allocated() noexcept {
+            batch_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        void on_retired(const std::size_t count, const std::size_t bytes) noexcept {
+            retired.fetch_add(count, std::memory_order_relaxed);
+            retired_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+        void on_advance() noexcept {
+            generation_advances.fetch_add(1, std::memory_order_relaxed);
+        }
+        void on_grace_period(const time_point start) noexcept {
+            grace_periods.fetch_add(1, std::memory_order_relaxed);
+            grace_period.record(now() - start);
+        }
+        void on_reclaim(const std::size_t count, const time_point start) noexcept {
+            reclaimed.fetch_add(count, std::memory_order_relaxed);
+            reclaim.record(now() - start);
+        }
+        void on_stall(const std::size_t gen) noexcept {
+            reader_stalls.fetch_add(1, std::memory_order_relaxed);
+            last_stalled_generation.store(gen, std::memory_order_relaxed);
+        }
+        void fill(rcu_stats& s) const noexcept {
+            s.retired = retired.load(std::memory_order_relaxed);
+            s.retired_bytes = retired_bytes.load(std::memory_order_relaxed);
+            s.generation_advances = generation_advances.load(std::memory_order_relaxed);
+            s.reclaimed = reclaimed.load(std::memory_order_relaxed);
+            s.batch_allocations = batch_allocations.load(std::memory_order_relaxed);
+            s.grace_periods = grace_periods.load(std::memory_order_relaxed);
+            s.reader_stalls = reader_stalls.load(std::memory_order_relaxed);
+            s.last_stalled_generation = last_stalled_generation.load(std::memory_order_relaxed);
+            s.grace_period = grace_period.snapshot();
+            s.reclaim = reclaim.snapshot();
+        }
+    };
+}
+
+
+#endif //RCU_STATS_H
@@ -0,0 +1,236 @@
+#ifndef RCU_UNORDERED_MAP_H
+#define RCU_UNORDERED_MAP_H
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "rcu.h"
+
+namespace rcu {
+    template<class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>, rcu_domain_type Domain = rcu_domain>
+    struct unordered_map {
+        using key_type = K;
+        using mapped_type = V;
+        static constexpr std::size_t num_stripes = 64;
+        static constexpr std::size_t max_load_factor = 1;
+
+        // immutable once published, except for the link to the next node in the chain
+        struct node : rcu_obj_base<node> {
+            const std::size_t hash;
+            const K key;
+            const V value;
+            std::atomic<node*> next;
+
+            node(const std::size_t hash, const K& key, const V& value, node* next) :
+                hash{hash}, key{key}, value{value}, next{next} {}
+        };
+        struct table : rcu_obj_base<table> {
+            std::size_t mask;
+            std::unique_ptr<std::atomic<node*>[]> buckets;
+
+            explicit table(const std::size_t size) : mask{size - 1}, buckets{new std::atomic<node*>[size]{}} {}
+            [[nodiscard]] std::size_t size() const noexcept {
+                return mask + 1;
+            }
+            std::atomic<node*>& bucket(const std::size_t hash) const noexcept {
+                return buckets[hash & mask];
+            }
+        };
+
+        // Readers only ever load _table and follow chains. Writers take _resize_lock shared plus the stripe
+        // of the key's bucket; since the bucket count is a multiple of num_stripes, each bucket has one stripe.
+        std::atomic<table*> _table;
+        std::shared_mutex _resize_lock;
+        std::array<std::mutex, num_stripes> _stripes;
+        std::atomic<std::size_t> _size;
+        [[no_unique_address]] Hash _hash;
+        [[no_unique_address]] KeyEqual _equal;
+        Domain& _domain;
+
+        explicit unordered_map(Domain& dom = rcu_default_domain()) :
+            _table{new table{num_stripes}}, _resize_lock{}, _stripes{}, _size{}, _hash{}, _equal{}, _domain{dom} {}
+        template<std::ranges::input_range R>
+        explicit unordered_map(R&& rg, Domain& dom = rcu_default_domain()) : unordered_map(dom) {
+            for (auto&& [k, v] : rg) {
+                insert(k, v);
+            }
+        }
+        unordered_map(unordered_map const&) = delete;
+        unordered_map(unordered_map&&) = delete;
+        unordered_map& operator=(unordered_map const&) = delete;
+        unordered_map& operator=(unordered_map&&) = delete;
+        ~unordered_map() {
+            auto* t = _table.load(std::memory_order_acquire);
+            for (auto&& head : std::span{t->buckets.get(), t->size()}) {
+                for (auto* n = head.load(std::memory_order_relaxed); n;) {
+                    delete std::exchange(n, n->next.load(std::memory_order_relaxed));
+                }
+            }
+            delete t;
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept {
+            return _size.load(std::memory_order_relaxed);
+        }
+        [[nodiscard]] std::size_t bucket_count() const noexcept {
+            return _table.load(std::memory_order_acquire)->size();
+        }
+
+        // only valid inside a read-side critical section of the map's domain
+        const V* find(const K& key) const noexcept {
+            const auto hash = _hash(key);
+            const auto* t = _table.load(std::memory_order_acquire);
+            for (auto* n = t->bucket(hash).load(std::memory_order_acquire); n; n = n->next.load(std::memory_order_acquire)) {
+                if (n->hash == hash && _equal(n->key, key))
+                    return &n->value;
+            }
+            return nullptr;
+        }
+        std::optional<V> get(const K& key) const {
+            std::scoped_lock guard{_domain};
+            const auto* value = find(key);
+            return value ? std::optional<V>{*value} : std::nullopt;
+        }
+        bool contains(const K& key) const {
+            std::scoped_lock guard{_domain};
+            return find(key) != nullptr;
+        }
+
+        bool insert(const K& key, const V& value) {
+            {
+                std::shared_lock resize_guard{_resize_lock};
+                const auto hash = _hash(key);
+                std::scoped_lock guard{stripe(hash)};
+                auto& head = _table.load(std::memory_order_relaxed)->bucket(hash);
+                if (find_link(head, hash, key))
+                    return false;
+                head.store(new node{hash, key, value, head.load(std::memory_order_relaxed)}, std::memory_order_release);
+            }
+            grow_if_needed(_size.fetch_add(1, std::memory_order_relaxed) + 1);
+            return true;
+        }
+        void insert_or_assign(const K& key, const V& value) {
+            {
+                std::shared_lock resize_guard{_resize_lock};
+                const auto hash = _hash(key);
+                std::scoped_lock guard{stripe(hash)};
+                auto& head = _table.load(std::memory_order_relaxed)->bucket(hash);
+                if (auto* link = find_link(head, hash, key)) {
+                    auto* old = link->load(std::memory_order_relaxed);
+                    link->store(new node{hash, key, value, old->next.load(std::memory_order_relaxed)}, std::memory_order_release);
+                    old->retire({}, _domain);
+                    return;
+                }
+                head.store(new node{hash, key, value, head.load(std::memory_order_relaxed)}, std::memory_order_release);
+            }
+            grow_if_needed(_size.fetch_add(1, std::memory_order_relaxed) + 1);
+        }
+        bool erase(const K& key) {
+            std::shared_lock resize_guard{_resize_lock};
+            const auto hash = _hash(key);
+            std::scoped_lock guard{stripe(hash)};
+            auto* link = find_link(_table.load(std::memory_order_relaxed)->bucket(hash), hash, key);
+            if (!link)
+                return false;
+            auto* old = link->load(std::memory_order_relaxed);
+            link->store(old->next.load(std::memory_order_relaxed), std::memory_order_release);
+            old->retire({}, _domain);
+            _size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Publishes a new bucket array holding copies of every node; readers keep using the old array and
+        // its nodes until they leave their critical section, after which both are reclaimed.
+        void rehash(const std::size_t count) {
+            std::unique_lock guard{_resize_lock};
+            rehash_locked(count);
+        }
+
+    private:
+        std::mutex& stripe(const std::size_t hash) noexcept {
+            return _stripes[hash % num_stripes];
+        }
+        std::atomic<node*>* find_link(std::atomic<node*>& head, const std::size_t hash, const K& key) {
+            for (auto* link = &head; auto* n = link->load(std::memory_order_relaxed); link = &n->next) {
+                if (n->hash == hash && _equal(n->key, key))
+                    return link;
+            }
+            return nullptr;
+        }
+        void grow_if_needed(const std::size_t size) {
+            if (size <= bucket_count() * max_load_factor) [[likely]]
+                return;
+            std::unique_lock guard{_resize_lock};
+            const auto buckets = _table.load(std::memory_order_relaxed)->size();
+            if (_size.load(std::memory_order_relaxed) > buckets * max_load_factor)
+                rehash_locked(2 * buckets);
+        }
+        void rehash_locked(const std::size_t count) {
+            auto* old = _table.load(std::memory_order_relaxed);
+            const auto size = std::bit_ceil(std::max(count, num_stripes));
+            if (size == old->size())
+                return;
+
+            auto* t = new table{size};
+            for (auto&& head : std::span{old->buckets.get(), old->size()}) {
+                for (auto* n = head.load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed)) {
+                    auto& bucket = t->bucket(n->hash);
+                    bucket.store(new node{n->hash, n->key, n->value, bucket.load(std::memory_order_relaxed)}, std::memory_order_relaxed);
+                }
+            }
+            _table.store(t, std::memory_order_release);
+
+            for (auto&& head : std::span{old->buckets.get(), old->size()}) {
+                for (auto* n = head.load(std::memory_order_relaxed); n;) {
+                    std::exchange(n, n->next.load(std::memory_order_relaxed))->retire({}, _domain);
+                }
+            }
+            old->retire({}, _domain);
+        }
+    };
+
+    template<class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+    struct shared_mutex_unordered_map {
+        using key_type = K;
+        using mapped_type = V;
+
+        std::shared_mutex _lock;
+        std::unordered_map<K, V, Hash, KeyEqual> _map;
+
+        shared_mutex_unordered_map() : _lock{}, _map{} {}
+        template<std::ranges::input_range R>
+        explicit shared_mutex_unordered_map(R&& rg) : _lock{}, _map{} {
+            for (auto&& [k, v] : rg) {
+                _map.emplace(k, v);
+            }
+        }
+        shared_mutex_unordered_map(shared_mutex_unordered_map const&) = delete;
+        shared_mutex_unordered_map(shared_mutex_unordered_map&&) = delete;
+        shared_mutex_unordered_map& operator=(shared_mutex_unordered_map const&) = delete;
+        shared_mutex_unordered_map& operator=(shared_mutex_unordered_map&&) = delete;
+
+        std::optional<V> get(const K& key) {
+            std::shared_lock guard{_lock};
+            const auto it = _map.find(key);
+            return it == _map.end() ? std::nullopt : std::optional<V>{it->second};
+        }
+        void insert_or_assign(const K& key, const V& value) {
+            std::unique_lock guard{_lock};
+            _map.insert_or_assign(key, value);
+        }
+        bool erase(const K& key) {
+            std::unique_lock guard{_lock};
+            return _map.erase(key) != 0;
+        }
+    };
+}
+
+
+#endif //RCU_UNORDERED_MAP_H